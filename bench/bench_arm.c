@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+ #include <malloc.h>
+ #define BENCH_MALLINFO2
+#endif
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+/* Arm, search and disarm throughput against the number of pending entries, for each queue backend, along with
+ * the resident memory taken by each pending entry.
+ *
+ * Usage: bench_arm [max entries]
+ *
+ * CSV columns: bench,backend,entries,ops,seconds,ops_per_sec,ns_per_op,bytes_per_entry
+ */
+
+#define ENTRIES_MAX	10000000
+
+static const char *backends[] = { "heap", "wheel" };
+
+void timer_handler(void *arg) {
+	return;
+}
+
+double elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1000000000.0);
+}
+
+/* Heap memory in use, in bytes, or the resident set size where the allocator can't tell (0 if unknown) */
+long allocated(void) {
+#ifdef BENCH_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+
+	return (long) (mi.uordblks + mi.hblkhd);
+#else
+	FILE *fp = NULL;
+	long size = 0, pages = 0;
+
+	if (!(fp = fopen("/proc/self/statm", "r")))
+		return 0;
+
+	if (fscanf(fp, "%ld %ld", &size, &pages) != 2)
+		pages = 0;
+
+	fclose(fp);
+
+	return pages * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void report(const char *bench, int backend, size_t entries, size_t ops, double seconds, long bytes) {
+	printf("%s,%s,%lu,%lu,%.6f,%.0f,%.1f,%ld\n", bench, backends[backend], (unsigned long) entries, (unsigned long) ops, seconds, seconds > 0 ? ops / seconds : 0, ops ? (seconds * 1000000000.0) / ops : 0, bytes);
+}
+
+int bench(int backend, size_t entries, pschedid_t *ids) {
+	psched_attr_t attr;
+	psched_t *h = NULL;
+	struct timespec start, delay, step, expire;
+	long mem = 0;
+	size_t i = 0;
+
+	psched_attr_init(&attr);
+
+	attr.backend = backend;
+	attr.clockid = CLOCK_MONOTONIC;
+
+	if (!(h = psched_thread_init_ex(&attr))) {
+		fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+		return -1;
+	}
+
+	mem = allocated();
+
+	/* Spread the entries over the second hour, so none of them fires while the benchmark runs */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < entries; i ++) {
+		delay.tv_sec = 3600 + (rand() % 3600);
+		delay.tv_nsec = rand() % 1000000000;
+
+		if ((ids[i] = psched_timespec_arm_in(h, &delay, NULL, NULL, &timer_handler, NULL, NULL)) == (pschedid_t) -1) {
+			fprintf(stderr, "psched_timespec_arm_in(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return -1;
+		}
+	}
+
+	report("arm", backend, entries, entries, elapsed(&start), (allocated() - mem) / (long) entries);
+
+	/* Look up random entries */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < entries; i ++)
+		psched_search(h, ids[rand() % entries], &delay, &step, &expire);
+
+	report("search", backend, entries, entries, elapsed(&start), 0);
+
+	/* Disarm them in arming order, which is random with respect to their triggers */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < entries; i ++) {
+		if (psched_disarm(h, ids[i]) < 0) {
+			fprintf(stderr, "psched_disarm(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return -1;
+		}
+	}
+
+	report("disarm", backend, entries, entries, elapsed(&start), 0);
+
+	psched_destroy(h);
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	pschedid_t *ids = NULL;
+	size_t max = ENTRIES_MAX, entries = 0;
+	int backend = 0;
+
+	if (argc > 1)
+		max = strtoul(argv[1], NULL, 10);
+
+	if (!max || !(ids = malloc(max * sizeof(pschedid_t)))) {
+		fprintf(stderr, "usage: %s [max entries]\n", argv[0]);
+
+		return 1;
+	}
+
+	/* Touch the id array up front, so it doesn't count towards the resident memory taken by the entries */
+	memset(ids, 0, max * sizeof(pschedid_t));
+
+	printf("bench,backend,entries,ops,seconds,ops_per_sec,ns_per_op,bytes_per_entry\n");
+
+	for (backend = PSCHED_BACKEND_HEAP; backend <= PSCHED_BACKEND_WHEEL; backend ++) {
+		for (entries = 1; entries <= max; entries *= 10) {
+			if (bench(backend, entries, ids) < 0) {
+				free(ids);
+
+				return 1;
+			}
+
+			fflush(stdout);
+		}
+	}
+
+	free(ids);
+
+	/* All good */
+	return 0;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+#include "timer_ul.h"
+
+/* Fire time jitter (how late the notification runs after the requested time) of one-shot and recurring timers,
+ * on the kernel timer_create() path, on the userland timer_create_ul() path and through a psched handler (which
+ * uses the path the library was built with). Builds using the userland timers are meant for platforms lacking the
+ * kernel ones, so the kernel path is only measured when the library uses it. Raw timer percentiles are exact; psched percentiles come from the
+ * handler latency histograms. Recurring notifications are measured against the latest period that went by, so
+ * periods missed altogether are skipped, as psched itself does.
+ *
+ * Usage: bench_jitter [samples] [interval in microseconds]
+ *
+ * CSV columns: bench,engine,mode,samples,p50_ns,p99_ns,p999_ns,max_ns
+ */
+
+#define SAMPLES		500
+#define INTERVAL	5000
+
+#ifdef PSCHED_INTERNAL_TIMER_UL
+ #define PSCHED_ENGINE	"psched_timer_ul"
+#else
+ #define PSCHED_ENGINE	"psched_kernel"
+#endif
+
+struct run {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct timespec expected;	/* Time the next notification is expected at */
+	struct timespec interval;	/* Zero for one-shot runs */
+	uint64_t *samples;
+	int count;
+	int total;
+};
+
+static struct run run = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+uint64_t lateness(const struct timespec *expected, const struct timespec *now) {
+	int64_t ns = (int64_t) (now->tv_sec - expected->tv_sec) * 1000000000 + (now->tv_nsec - expected->tv_nsec);
+
+	return ns > 0 ? (uint64_t) ns : 0;
+}
+
+void timespec_step(struct timespec *ts, const struct timespec *step) {
+	ts->tv_sec += step->tv_sec;
+	ts->tv_nsec += step->tv_nsec;
+
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec ++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+int cmp(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+void notify(union sigval sv) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&run.mutex);
+
+	if (run.count < run.total) {
+		/* Skip the periods that went by since the expected one */
+		while ((run.interval.tv_sec || run.interval.tv_nsec) && (lateness(&run.expected, &now) >= (uint64_t) run.interval.tv_sec * 1000000000 + run.interval.tv_nsec))
+			timespec_step(&run.expected, &run.interval);
+
+		run.samples[run.count ++] = lateness(&run.expected, &now);
+
+		timespec_step(&run.expected, &run.interval);
+	}
+
+	pthread_cond_signal(&run.cond);
+	pthread_mutex_unlock(&run.mutex);
+}
+
+void routine(void *arg) {
+	pthread_mutex_lock(&run.mutex);
+
+	run.count ++;
+
+	pthread_cond_signal(&run.cond);
+	pthread_mutex_unlock(&run.mutex);
+}
+
+void wait_for(int count) {
+	pthread_mutex_lock(&run.mutex);
+
+	while (run.count < count)
+		pthread_cond_wait(&run.cond, &run.mutex);
+
+	pthread_mutex_unlock(&run.mutex);
+}
+
+void report(const char *engine, const char *mode, uint64_t p50, uint64_t p99, uint64_t p999, uint64_t max) {
+	printf("jitter,%s,%s,%d,%llu,%llu,%llu,%llu\n", engine, mode, run.total, (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) p999, (unsigned long long) max);
+}
+
+int bench_timer(
+		const char *engine,
+		int (*create) (clockid_t, struct sigevent *, timer_t *),
+		int (*settime) (timer_t, int, const struct itimerspec *, struct itimerspec *),
+		int (*delete) (timer_t),
+		const struct timespec *interval,
+		int recurring)
+{
+	struct sigevent sevp;
+	struct itimerspec its;
+	timer_t timer;
+	int i = 0;
+
+	memset(&sevp, 0, sizeof(struct sigevent));
+	memset(&its, 0, sizeof(struct itimerspec));
+
+	sevp.sigev_notify = SIGEV_THREAD;
+	sevp.sigev_notify_function = &notify;
+
+	if (create(CLOCK_MONOTONIC, &sevp, &timer) < 0) {
+		fprintf(stderr, "%s: timer_create(): %s\n", engine, strerror(errno));
+
+		return -1;
+	}
+
+	run.count = 0;
+
+	if (recurring) {
+		/* A single periodic timer */
+		pthread_mutex_lock(&run.mutex);
+
+		clock_gettime(CLOCK_MONOTONIC, &run.expected);
+		timespec_step(&run.expected, interval);
+
+		run.interval = *interval;
+
+		its.it_value = run.expected;
+		its.it_interval = *interval;
+
+		settime(timer, TIMER_ABSTIME, &its, NULL);
+
+		pthread_mutex_unlock(&run.mutex);
+
+		wait_for(run.total);
+
+		memset(&its, 0, sizeof(struct itimerspec));
+
+		settime(timer, 0, &its, NULL);
+	} else {
+		/* The timer is armed again once the previous notification ran */
+		memset(&run.interval, 0, sizeof(struct timespec));
+
+		for (i = 0; i < run.total; i ++) {
+			pthread_mutex_lock(&run.mutex);
+
+			clock_gettime(CLOCK_MONOTONIC, &run.expected);
+			timespec_step(&run.expected, interval);
+
+			its.it_value = run.expected;
+
+			settime(timer, TIMER_ABSTIME, &its, NULL);
+
+			pthread_mutex_unlock(&run.mutex);
+
+			wait_for(i + 1);
+		}
+	}
+
+	delete(timer);
+
+	qsort(run.samples, run.total, sizeof(uint64_t), &cmp);
+
+	report(engine, recurring ? "recurring" : "oneshot", run.samples[run.total / 2], run.samples[(run.total * 99) / 100], run.samples[(run.total * 999) / 1000], run.samples[run.total - 1]);
+
+	return 0;
+}
+
+int bench_psched(const struct timespec *interval, int recurring) {
+	psched_attr_t attr;
+	psched_stats_t stats;
+	psched_t *h = NULL;
+	pschedid_t id = 0;
+	int i = 0;
+
+	psched_attr_init(&attr);
+
+	attr.clockid = CLOCK_MONOTONIC;
+
+	if (!(h = psched_thread_init_ex(&attr))) {
+		fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+		return -1;
+	}
+
+	psched_stats_enable(h, 1);
+
+	run.count = 0;
+
+	if (recurring) {
+		id = psched_timespec_arm_in(h, (struct timespec *) interval, (struct timespec *) interval, NULL, &routine, NULL, NULL);
+
+		wait_for(run.total);
+
+		psched_disarm(h, id);
+	} else {
+		for (i = 0; i < run.total; i ++) {
+			psched_timespec_arm_in(h, (struct timespec *) interval, NULL, NULL, &routine, NULL, NULL);
+
+			wait_for(i + 1);
+		}
+	}
+
+	psched_stats_snapshot(h, &stats);
+
+	psched_destroy(h);
+
+	report(PSCHED_ENGINE, recurring ? "recurring" : "oneshot", stats.lateness.p50, stats.lateness.p99, stats.lateness.p999, stats.lateness.max);
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	struct timespec interval = { 0, INTERVAL * 1000 };
+	int recurring = 0;
+
+	run.total = SAMPLES;
+
+	if (argc > 1)
+		run.total = atoi(argv[1]);
+
+	if (argc > 2) {
+		interval.tv_sec = atoi(argv[2]) / 1000000;
+		interval.tv_nsec = (atoi(argv[2]) % 1000000) * 1000;
+	}
+
+	if ((run.total <= 0) || !(interval.tv_sec || interval.tv_nsec) || !(run.samples = malloc(run.total * sizeof(uint64_t)))) {
+		fprintf(stderr, "usage: %s [samples] [interval in microseconds]\n", argv[0]);
+
+		return 1;
+	}
+
+	printf("bench,engine,mode,samples,p50_ns,p99_ns,p999_ns,max_ns\n");
+
+	for (recurring = 0; recurring <= 1; recurring ++) {
+#ifndef PSCHED_INTERNAL_TIMER_UL
+		if (bench_timer("kernel", &timer_create, &timer_settime, &timer_delete, &interval, recurring) < 0)
+			return 1;
+#endif
+
+		if (bench_timer("timer_ul", &timer_create_ul, &timer_settime_ul, &timer_delete_ul, &interval, recurring) < 0)
+			return 1;
+
+		if (bench_psched(&interval, recurring) < 0)
+			return 1;
+
+		fflush(stdout);
+	}
+
+	free(run.samples);
+
+	/* All good */
+	return 0;
+}
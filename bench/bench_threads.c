@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+/* Arm and disarm throughput with 1 to 64 threads sharing a single handler, and sharing a sharded handler with
+ * one shard per thread.
+ *
+ * Usage: bench_threads [entries per thread]
+ *
+ * CSV columns: bench,handler,threads,ops,seconds,ops_per_sec
+ */
+
+#define ENTRIES		20000
+#define THREADS_MAX	64
+
+struct worker {
+	pthread_t tid;
+	psched_t *handler;
+	psched_sharded_t *sharded;
+	pschedid_t *ids;
+	size_t entries;
+	int failed;
+};
+
+static pthread_barrier_t barrier;
+
+void timer_handler(void *arg) {
+	return;
+}
+
+double elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1000000000.0);
+}
+
+void *worker(void *arg) {
+	struct worker *w = arg;
+	struct timespec delay;
+	size_t i = 0;
+
+	pthread_barrier_wait(&barrier);
+
+	/* Arm all the entries, far enough in the future so none of them fires, then disarm them */
+	for (i = 0; i < w->entries; i ++) {
+		delay.tv_sec = 3600 + (i % 3600);
+		delay.tv_nsec = (i * 7919) % 1000000000;
+
+		if (w->sharded)
+			w->ids[i] = psched_sharded_arm_in(w->sharded, &delay, NULL, NULL, &timer_handler, NULL, NULL);
+		else
+			w->ids[i] = psched_timespec_arm_in(w->handler, &delay, NULL, NULL, &timer_handler, NULL, NULL);
+
+		if (w->ids[i] == (pschedid_t) -1)
+			w->failed = 1;
+	}
+
+	for (i = 0; i < w->entries; i ++) {
+		if (w->ids[i] == (pschedid_t) -1)
+			continue;
+
+		if (w->sharded)
+			psched_sharded_disarm(w->sharded, w->ids[i]);
+		else
+			psched_disarm(w->handler, w->ids[i]);
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	return NULL;
+}
+
+int bench(int sharded, int threads, size_t entries, struct worker *workers) {
+	psched_attr_t attr;
+	psched_t *h = NULL;
+	psched_sharded_t *s = NULL;
+	struct timespec start;
+	double seconds = 0;
+	int i = 0, failed = 0;
+
+	psched_attr_init(&attr);
+
+	attr.clockid = CLOCK_MONOTONIC;
+
+	if (sharded && !(s = psched_sharded_init(threads, &attr))) {
+		fprintf(stderr, "psched_sharded_init(): %s\n", strerror(errno));
+
+		return -1;
+	} else if (!sharded && !(h = psched_thread_init_ex(&attr))) {
+		fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+		return -1;
+	}
+
+	pthread_barrier_init(&barrier, NULL, threads + 1);
+
+	for (i = 0; i < threads; i ++) {
+		workers[i].handler = h;
+		workers[i].sharded = s;
+		workers[i].entries = entries;
+		workers[i].failed = 0;
+
+		pthread_create(&workers[i].tid, NULL, &worker, &workers[i]);
+	}
+
+	/* Time from the moment all the threads are released until the last one is done */
+	pthread_barrier_wait(&barrier);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pthread_barrier_wait(&barrier);
+
+	seconds = elapsed(&start);
+
+	for (i = 0; i < threads; i ++) {
+		pthread_join(workers[i].tid, NULL);
+
+		failed |= workers[i].failed;
+	}
+
+	pthread_barrier_destroy(&barrier);
+
+	if (s)
+		psched_sharded_destroy(s);
+	else
+		psched_destroy(h);
+
+	if (failed) {
+		fprintf(stderr, "psched_timespec_arm_in(): failed\n");
+
+		return -1;
+	}
+
+	/* Each entry accounts for an arm and a disarm */
+	printf("arm_disarm,%s,%d,%lu,%.6f,%.0f\n", sharded ? "sharded" : "single", threads, (unsigned long) (threads * entries * 2), seconds, (threads * entries * 2) / seconds);
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	struct worker workers[THREADS_MAX];
+	size_t entries = ENTRIES;
+	int sharded = 0, threads = 0, i = 0;
+
+	if (argc > 1)
+		entries = strtoul(argv[1], NULL, 10);
+
+	if (!entries) {
+		fprintf(stderr, "usage: %s [entries per thread]\n", argv[0]);
+
+		return 1;
+	}
+
+	memset(workers, 0, sizeof(workers));
+
+	for (i = 0; i < THREADS_MAX; i ++) {
+		if (!(workers[i].ids = malloc(entries * sizeof(pschedid_t)))) {
+			fprintf(stderr, "malloc(): %s\n", strerror(errno));
+
+			return 1;
+		}
+	}
+
+	printf("bench,handler,threads,ops,seconds,ops_per_sec\n");
+
+	for (sharded = 0; sharded <= 1; sharded ++) {
+		for (threads = 1; threads <= THREADS_MAX; threads *= 2) {
+			if (bench(sharded, threads, entries, workers) < 0)
+				return 1;
+
+			fflush(stdout);
+		}
+	}
+
+	for (i = 0; i < THREADS_MAX; i ++)
+		free(workers[i].ids);
+
+	/* All good */
+	return 0;
+}
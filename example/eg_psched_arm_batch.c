@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+#define ENTRIES		200000
+
+void timer_handler(void *arg) {
+	return;
+}
+
+double elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + ((now.tv_nsec - start->tv_nsec) / 1000000000.0);
+}
+
+int main(void) {
+	psched_t *h;
+	psched_arm_req_t *reqs;
+	pschedid_t *ids;
+	struct timespec start;
+	int i = 0;
+
+	reqs = calloc(ENTRIES, sizeof(psched_arm_req_t));
+	ids = calloc(ENTRIES, sizeof(pschedid_t));
+
+	if (!reqs || !ids) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+
+		return 1;
+	}
+
+	/* Spread the entries over the next hour, so none of them fires while the schedule is loaded */
+	for (i = 0; i < ENTRIES; i ++) {
+		reqs[i].trigger.tv_sec = time(NULL) + 60 + (rand() % 3600);
+		reqs[i].trigger.tv_nsec = rand() % 1000000000;
+		reqs[i].routine = &timer_handler;
+	}
+
+	/* Arm the entries one by one */
+	if (!(h = psched_thread_init())) {
+		fprintf(stderr, "psched_thread_init(): %s\n", strerror(errno));
+
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < ENTRIES; i ++) {
+		if (psched_timespec_arm(h, &reqs[i].trigger, NULL, NULL, reqs[i].routine, NULL) == (pschedid_t) -1) {
+			fprintf(stderr, "psched_timespec_arm(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return 1;
+		}
+	}
+
+	printf("psched_timespec_arm() x %d: %.3f s\n", ENTRIES, elapsed(&start));
+
+	psched_destroy(h);
+
+	/* Arm the same entries as a single batch */
+	if (!(h = psched_thread_init())) {
+		fprintf(stderr, "psched_thread_init(): %s\n", strerror(errno));
+
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (psched_timespec_arm_batch(h, reqs, ENTRIES, ids, NULL) < 0) {
+		fprintf(stderr, "psched_timespec_arm_batch(): %s\n", strerror(errno));
+		psched_destroy(h);
+
+		return 1;
+	}
+
+	printf("psched_timespec_arm_batch() of %d: %.3f s\n", ENTRIES, elapsed(&start));
+
+	psched_destroy(h);
+
+	free(reqs);
+	free(ids);
+
+	/* All good */
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+void timer_handler(void *arg) {
+	char *str = arg;
+
+	printf("[Timer]: %s\n", str);
+}
+
+int main(void) {
+	psched_t *h;
+	struct pollfd pfd;
+	struct timespec now, deadline;
+	int timeout = 0;
+
+	/* Initialize psched pollable interface. No threads nor signals are used. */
+	if (!(h = psched_fd_init())) {
+		fprintf(stderr, "psched_fd_init(): %s\n", strerror(errno));
+
+		return 1;
+	}
+
+	/* Arm the first timer */
+	if (psched_timestamp_arm(h, time(NULL) + 5, 0, 0, &timer_handler, "Hello! This timer has expired.") == (pschedid_t) - 1) {
+		fprintf(stderr, "psched_timestamp_arm(): %s\n", strerror(errno));
+		psched_destroy(h);
+
+		return 1;
+	}
+
+	/* Arm a second timer */
+	if (psched_timestamp_arm(h, time(NULL) + 7, 0, 0, &timer_handler, "Hello again! This timer also expired.") == (pschedid_t) - 1) {
+		fprintf(stderr, "psched_timestamp_arm(): %s\n", strerror(errno));
+		psched_destroy(h);
+
+		return 1;
+	}
+
+	pfd.fd = psched_fd(h);
+	pfd.events = POLLIN;
+
+	/* Run our own event loop until no timer is left. The descriptor could be watched along with any others. */
+	while (psched_next_deadline(h, &deadline)) {
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		/* The next deadline can also be folded into the timeout of an existing event loop */
+		timeout = (int) ((deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec) / 1000000) + 1;
+
+		printf("[Loop]: Waiting up to %d ms...\n", timeout > 0 ? timeout : 0);
+
+		if (poll(&pfd, 1, timeout > 0 ? timeout : 0) < 0) {
+			fprintf(stderr, "poll(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return 1;
+		}
+
+		/* Run the routines that are due, on this thread */
+		if ((pfd.revents & POLLIN) && (psched_dispatch(h, 0) < 0)) {
+			fprintf(stderr, "psched_dispatch(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return 1;
+		}
+	}
+
+	/* Free handler resources */
+	psched_destroy(h);
+
+	/* All good */
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+#define WORKERS		4
+#define BURSTS		200
+#define BURST_MAX	16
+
+static volatile int fired = 0;
+
+void timer_handler(void *arg) {
+	__sync_fetch_and_add(&fired, 1);
+}
+
+int main(void) {
+	psched_t *h;
+	psched_attr_t attr;
+	psched_arm_req_t reqs[BURST_MAX];
+	pschedid_t ids[BURST_MAX];
+	struct timespec now;
+	int i = 0, j = 0, armed = 0, last = -1;
+
+	/* Executor threads stealing the routines from each other */
+	psched_attr_init(&attr);
+
+	attr.workers = WORKERS;
+	attr.dispatch = PSCHED_DISPATCH_STEAL;
+
+	if (!(h = psched_thread_init_ex(&attr))) {
+		fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+		return 1;
+	}
+
+	/* Fire bursts of entries sharing the same trigger, so each wakeup hands several routines over to the
+	 * executor at once while the threads are still busy with the previous burst.
+	 */
+	memset(reqs, 0, sizeof(reqs));
+
+	for (i = 0; i < BURSTS; i ++) {
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		reqs[0].trigger = now;
+		reqs[0].trigger.tv_nsec += 1000000;
+
+		if (reqs[0].trigger.tv_nsec >= 1000000000) {
+			reqs[0].trigger.tv_sec ++;
+			reqs[0].trigger.tv_nsec -= 1000000000;
+		}
+
+		reqs[0].routine = &timer_handler;
+
+		for (j = 1; j < BURST_MAX; j ++)
+			memcpy(&reqs[j], &reqs[0], sizeof(psched_arm_req_t));
+
+		if (psched_timespec_arm_batch(h, reqs, (i % BURST_MAX) + 1, ids, NULL) < 0) {
+			fprintf(stderr, "psched_timespec_arm_batch(): %s\n", strerror(errno));
+			psched_destroy(h);
+
+			return 1;
+		}
+
+		armed += (i % BURST_MAX) + 1;
+
+		usleep(1000 + ((i % 3) * 500));
+	}
+
+	/* Wait for the routines to settle */
+	while (last != fired) {
+		last = fired;
+
+		usleep(100000);
+	}
+
+	printf("[Main]: %d of %d routines executed.\n", fired, armed);
+
+	/* Every queued routine was executed, so no entry is left in progress */
+	psched_destroy(h);
+
+	/* All good */
+	return (fired == armed) ? 0 : 1;
+}
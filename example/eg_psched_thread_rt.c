@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+/* #include <psched/psched.h> */
+#include "psched.h"
+
+void timer_handler(void *arg) {
+	char *str = arg;
+
+	printf("[Timer]: %s\n", str);
+}
+
+int main(void) {
+	psched_t *h;
+	psched_attr_t attr;
+
+	/* Request real-time scheduling for the threads running the routines */
+	psched_attr_init(&attr);
+
+	attr.policy = SCHED_FIFO;
+	attr.priority = 50;
+
+	/* Without the required privileges (CAP_SYS_NICE or a suitable RLIMIT_RTPRIO), initialization fails with
+	 * EPERM, instead of leaving a handler whose routines never run.
+	 */
+	if (!(h = psched_thread_init_ex(&attr))) {
+		if (errno != EPERM) {
+			fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+			return 1;
+		}
+
+		puts("[Main]: Real-time scheduling not permitted. Using the default scheduling policy.");
+
+		psched_attr_init(&attr);
+
+		if (!(h = psched_thread_init_ex(&attr))) {
+			fprintf(stderr, "psched_thread_init_ex(): %s\n", strerror(errno));
+
+			return 1;
+		}
+	}
+
+	/* Arm a timer */
+	if (psched_timestamp_arm(h, time(NULL) + 2, 0, 0, &timer_handler, "Hello! This timer has expired.") == (pschedid_t) - 1) {
+		fprintf(stderr, "psched_timestamp_arm(): %s\n", strerror(errno));
+		psched_destroy(h);
+
+		return 1;
+	}
+
+	/* Wait for the timer to expire */
+	sleep(3);
+
+	/* Free handler resources */
+	psched_destroy(h);
+
+	/* All good */
+	return 0;
+}
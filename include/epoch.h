@@ -0,0 +1,63 @@
+/**
+ * @file epoch.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Epoch based reclamation interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_EPOCH_H
+#define LIBPSCHED_EPOCH_H
+
+#include <stdint.h>
+
+/* Maximum number of concurrent lock-free readers. Readers that find no free
+ * slot fall back to the locked path.
+ */
+#define PSCHED_EPOCH_READERS	32
+
+/* Number of retired objects accumulated before reclaiming them */
+#define PSCHED_EPOCH_BATCH	64
+
+/* Objects unlinked by a writer are retired with the current epoch and only
+ * reused once every reader that may still hold a reference to them has left.
+ * Readers announce the epoch they entered on a slot of their own, padded to
+ * a cache line so readers don't contend with each other.
+ */
+struct psched_epoch_reader {
+	uint64_t epoch;		/* Epoch this reader entered (0 if the slot is free) */
+	char pad[64 - sizeof(uint64_t)];
+};
+
+struct psched_epoch {
+	uint64_t global;
+	struct psched_epoch_reader readers[PSCHED_EPOCH_READERS];
+};
+
+/* Prototypes */
+void epoch_init(struct psched_epoch *epoch);
+int epoch_enter(struct psched_epoch *epoch);
+void epoch_leave(struct psched_epoch *epoch, int slot);
+uint64_t epoch_retire(const struct psched_epoch *epoch);
+uint64_t epoch_sync(struct psched_epoch *epoch);
+
+#endif
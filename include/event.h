@@ -30,6 +30,6 @@
 
 #include "psched.h"
 
-void event_process(psched_t *handler);
+int event_process(psched_t *handler, unsigned int max);
 
 #endif
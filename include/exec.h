@@ -0,0 +1,81 @@
+/**
+ * @file exec.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Executor interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_EXEC_H
+#define LIBPSCHED_EXEC_H
+
+#include <pthread.h>
+
+/* Executor flags */
+#define EXEC_STEAL	0x01	/* Per-thread deques with work stealing, instead of a shared FIFO */
+
+/* Work item. Embedded by the caller, so submitting work never allocates. */
+struct exec_work {
+	void (*routine) (void *);
+	void *arg;
+	int queued;			/* Set while waiting on the executor queue */
+	struct exec_work *next;
+	struct exec_work *prev;		/* Work stealing deques only */
+	struct exec_thread *owner;	/* Deque the item is queued on (work stealing only) */
+};
+
+struct exec_thread {
+	pthread_t id;
+	struct exec_work *current;	/* Work item being executed, if any */
+	struct psched_exec *exec;
+
+	/* Work stealing deque. The owner takes from the head, thieves from the tail. */
+	pthread_mutex_t lock;
+	struct exec_work *head;
+	struct exec_work *tail;
+};
+
+/* Fixed-size pool of persistent threads consuming a FIFO of work items, or
+ * per-thread deques when EXEC_STEAL is set.
+ */
+struct psched_exec {
+	struct exec_thread *threads;
+	unsigned int nthreads;
+	int flags;
+	int stop;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_cond_t done;
+	struct exec_work *head;
+	struct exec_work **tail;
+	size_t pending;			/* Unclaimed items on the deques (work stealing only) */
+	size_t orphaned;		/* Claims on items cancelled meanwhile (work stealing only) */
+	unsigned int next;		/* Next deque to submit to (work stealing only) */
+};
+
+/* Prototypes */
+int exec_init(struct psched_exec *exec, unsigned int nthreads, int flags, const pthread_attr_t *attr);
+void exec_destroy(struct psched_exec *exec);
+int exec_submit(struct psched_exec *exec, struct exec_work *work);
+void exec_cancel(struct psched_exec *exec, struct exec_work *work);
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * @file fd.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Pollable descriptor interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_FD_H
+#define LIBPSCHED_FD_H
+
+#include <time.h>
+
+#include "psched.h"
+
+/* Prototypes */
+int fd_init(psched_t *handler);
+void fd_destroy(psched_t *handler);
+int fd_settime(psched_t *handler, const struct itimerspec *its);
+void fd_clear(psched_t *handler);
+
+#endif
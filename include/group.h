@@ -0,0 +1,63 @@
+/**
+ * @file group.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Entry group interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_GROUP_H
+#define LIBPSCHED_GROUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mm.h"
+
+struct psched_entry;
+
+/* Entries armed with a group tag are linked on an intrusive list owned by
+ * their group, so a whole group can be walked in O(group size). Groups are
+ * created on the first member and released with the last one, and are looked
+ * up by tag on a hash table.
+ */
+struct psched_group {
+	uintptr_t tag;
+	struct psched_entry *entries;	/* Members */
+	struct psched_group *next;	/* Next group on the same bucket */
+};
+
+struct psched_groups {
+	struct psched_group **buckets;
+	size_t size;			/* Number of buckets (power of 2) */
+	size_t count;			/* Number of groups */
+	struct mm_pool pool;		/* Group nodes */
+};
+
+/* Prototypes */
+int group_init(struct psched_groups *groups);
+void group_destroy(struct psched_groups *groups);
+int group_add(struct psched_groups *groups, struct psched_entry *entry, uintptr_t tag);
+void group_del(struct psched_groups *groups, struct psched_entry *entry);
+struct psched_group *group_lookup(const struct psched_groups *groups, uintptr_t tag);
+
+#endif
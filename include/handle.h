@@ -0,0 +1,78 @@
+/**
+ * @file handle.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Entry handle table interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_HANDLE_H
+#define LIBPSCHED_HANDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct psched_entry;
+
+/* Entry identifiers combine a slot index (low bits) with the generation of
+ * that slot (middle bits). The generation is bumped whenever a slot is
+ * released, so identifiers of removed entries are never resolved again, even
+ * if the slot is reused. The top bits are reserved for the shard index of
+ * sharded handlers, and ignored by the handle table.
+ */
+#define PSCHED_HANDLE_SHARD_BITS	((sizeof(uintptr_t) > 4) ? 8 : 4)
+#define PSCHED_HANDLE_SLOT_BITS		((sizeof(uintptr_t) > 4) ? 32 : 20)
+#define PSCHED_HANDLE_SLOT_MASK		(((uintptr_t) 1 << PSCHED_HANDLE_SLOT_BITS) - 1)
+#define PSCHED_HANDLE_GEN_MASK		(((uintptr_t) -1) >> (PSCHED_HANDLE_SLOT_BITS + PSCHED_HANDLE_SHARD_BITS))
+#define PSCHED_HANDLE_SHARD_SHIFT	((sizeof(uintptr_t) * 8) - PSCHED_HANDLE_SHARD_BITS)
+
+struct psched_handle {
+	struct psched_entry *entry;	/* NULL if the slot is free */
+	uintptr_t gen;
+	size_t next_free;		/* Next free slot (index + 1, 0 if none) */
+};
+
+/* Lookups may run concurrently with a single writer. The table is replaced
+ * when it grows, and the replaced ones are only released along with the
+ * handle table, as lock-free readers may still be walking them. Since the
+ * table doubles on every growth, they never add up to its current size.
+ */
+struct psched_handles {
+	struct psched_handle *slots;
+	size_t count;		/* Slots in use */
+	size_t used;		/* Slots ever used (high watermark) */
+	size_t size;		/* Slots allocated */
+	size_t free;		/* First free slot (index + 1, 0 if none) */
+	struct psched_handle *retired[sizeof(size_t) * 8];	/* Tables replaced on growth */
+	unsigned int nretired;
+};
+
+/* Prototypes */
+int handle_init(struct psched_handles *handles, size_t size);
+void handle_destroy(struct psched_handles *handles);
+uintptr_t handle_alloc(struct psched_handles *handles, struct psched_entry *entry);
+struct psched_entry *handle_lookup(const struct psched_handles *handles, uintptr_t id);
+int handle_match(uintptr_t id1, uintptr_t id2);
+void handle_release(struct psched_handles *handles, uintptr_t id);
+struct psched_entry *handle_iterate(const struct psched_handles *handles, size_t *pos);
+
+#endif
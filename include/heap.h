@@ -0,0 +1,52 @@
+/**
+ * @file heap.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Deadline ordered priority queue interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_HEAP_H
+#define LIBPSCHED_HEAP_H
+
+#include <stddef.h>
+
+struct psched_entry;
+
+/* Binary min-heap of entries, ordered by deadline. Each entry stores its own
+ * position (entry->heap_pos, 1-based, 0 when not queued) so it can be removed
+ * in O(log n) without searching.
+ */
+struct psched_heap {
+	struct psched_entry **nodes;
+	size_t count;
+	size_t size;
+};
+
+/* Prototypes */
+int heap_init(struct psched_heap *heap, size_t size);
+void heap_destroy(struct psched_heap *heap);
+int heap_insert(struct psched_heap *heap, struct psched_entry *entry);
+void heap_remove(struct psched_heap *heap, struct psched_entry *entry);
+struct psched_entry *heap_top(const struct psched_heap *heap);
+
+#endif
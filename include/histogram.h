@@ -0,0 +1,64 @@
+/**
+ * @file histogram.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Latency histogram interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_HISTOGRAM_H
+#define LIBPSCHED_HISTOGRAM_H
+
+#include <stdint.h>
+
+/* Log-linear histogram of nanosecond values. Each power of two is split in
+ * 2^HISTOGRAM_SUB_BITS linear buckets, so a value is known within 1/16 of
+ * itself. Buckets are updated with atomic increments, so values can be
+ * recorded concurrently and read without locking.
+ */
+#define HISTOGRAM_SUB_BITS	4
+#define HISTOGRAM_SUB_BUCKETS	(1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MSB_MAX	43	/* Larger values (over ~2.4 hours) are accounted on the last bucket */
+#define HISTOGRAM_BUCKETS	((HISTOGRAM_MSB_MAX - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_BUCKETS)
+
+struct psched_histogram {
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t sum;
+	uint64_t max;
+};
+
+/* Summary of a histogram */
+struct histogram_summary {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+/* Prototypes */
+void histogram_record(struct psched_histogram *hist, uint64_t value);
+void histogram_summary(const struct psched_histogram *hist, struct histogram_summary *summary);
+void histogram_merge(struct psched_histogram *dst, const struct psched_histogram *src);
+
+#endif
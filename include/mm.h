@@ -28,13 +28,33 @@
 #ifndef LIBPSCHED_MM_H
 #define LIBPSCHED_MM_H
 
+#include <stddef.h>
+
 #ifdef USE_LIBFSMA
  #include <fsma/fsma.h>
 #endif
 
+/* Fixed-size object pool. Objects are carved from chunks allocated through
+ * mm_alloc() and recycled through a free list, so steady-state allocations
+ * don't reach the system allocator. All chunks are released at once by
+ * mm_pool_destroy().
+ */
+struct mm_pool {
+	size_t size;		/* Object size (aligned) */
+	size_t nmemb;		/* Objects on the next chunk */
+	void *chunks;		/* Allocated chunks */
+	void *free;		/* Free objects */
+	size_t avail;		/* Number of free objects */
+};
+
 void *mm_alloc(size_t size);
 void mm_free(void *ptr);
 void *mm_realloc(void *ptr, size_t size);
 void *mm_calloc(size_t nmemb, size_t size);
+int mm_pool_init(struct mm_pool *pool, size_t size, size_t hint);
+void mm_pool_destroy(struct mm_pool *pool);
+int mm_pool_reserve(struct mm_pool *pool, size_t nmemb);
+void *mm_pool_alloc(struct mm_pool *pool);
+void mm_pool_free(struct mm_pool *pool, void *ptr);
 
 #endif
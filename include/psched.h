@@ -33,47 +33,224 @@
 #include <time.h>
 #include <pthread.h>
 
-#include <pall/cll.h>
-
+#include "epoch.h"
+#include "exec.h"
+#include "group.h"
+#include "handle.h"
+#include "heap.h"
+#include "histogram.h"
 #include "mm.h"
+#include "submit.h"
 #include "timer_ul.h"
+#include "wheel.h"
+
+
+/* Scheduling queue backends */
+#define PSCHED_BACKEND_HEAP	0	/* Deadline ordered min-heap (default) */
+#define PSCHED_BACKEND_WHEEL	1	/* Hierarchical timing wheel, for coarse deadlines */
+
+/* Dispatch modes of the routines offloaded to the executor threads */
+#define PSCHED_DISPATCH_SHARED	0	/* Single FIFO shared by all the executor threads (default) */
+#define PSCHED_DISPATCH_STEAL	1	/* Per-thread deques, with idle threads stealing from busy ones */
 
+/* CPU affinity mask of the library threads */
+#define PSCHED_AFFINITY_WORDS	16	/* Up to 1024 CPUs */
+#define PSCHED_AFFINITY_SET(cpu, attr)	((attr)->affinity[(cpu) / 64] |= ((uint64_t) 1 << ((cpu) % 64)))
+
+/* Entry flags */
+#define PSCHED_ARM_INLINE	0x01	/* Run the routine on the notification thread, bypassing the executor */
+
+/* Catch-up policies of recurrent entries that missed some of their periods */
+#define PSCHED_CATCHUP_ONCE	0	/* Fire once for all the missed periods and carry on with the next one (default) */
+#define PSCHED_CATCHUP_ALL	1	/* Fire once per missed period, back to back */
+#define PSCHED_CATCHUP_SKIP	2	/* Don't fire late by a whole period or more, skip to the next one instead */
 
 typedef uintptr_t pschedid_t;
 
+typedef struct psched_attr {
+	int backend;		/* Scheduling queue backend (PSCHED_BACKEND_*) */
+	struct timespec tick;	/* Timing wheel resolution (0 for default) */
+	size_t entries;		/* Number of entries to preallocate (0 for none) */
+	unsigned int workers;	/* Executor threads running the routines (0 runs them on the notification thread) */
+	int dispatch;		/* Dispatch mode of the executor threads (PSCHED_DISPATCH_*) */
+
+	/* Attributes of the threads created by the library (notification and executor threads). With userland
+	 * timers, the threads waiting for the expirations are shared by the whole process, so these can only be
+	 * set on the first handler. Attributes the process can't apply make the initialization fail (EPERM for a real-time
+	 * policy without the required privileges).
+	 */
+	uint64_t affinity[PSCHED_AFFINITY_WORDS];	/* CPUs the threads may run on (none set for any) */
+	int policy;		/* Scheduling policy (SCHED_OTHER, SCHED_FIFO or SCHED_RR) */
+	int priority;		/* Scheduling priority, for SCHED_FIFO and SCHED_RR */
+	size_t stacksize;	/* Stack size (0 for default) */
+	clockid_t clockid;	/* Clock the triggers are set on (CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME) */
+
+	/* On submission mode, arms and disarms never wait for the event processing. They only serialize on a
+	 * short critical section allocating or hiding the entry, as long as the entries fit the preallocated ones
+	 * ('entries', or 4096 if not set). Past that, the arm growing the entry pool or the handle table does so
+	 * within that section, which the other arms and disarms then wait for.
+	 */
+	int submit;		/* Queue arms and disarms without the event mutex (threaded handlers only) */
+} psched_attr_t;
+
+typedef struct psched_arm_attr {
+	int flags;		/* Entry flags (PSCHED_ARM_*) */
+	uintptr_t group;	/* Group tag, for psched_disarm_group() (0 for none) */
+	struct timespec slack;	/* Tolerated lateness, so nearby entries can share a wakeup */
+	int catchup;		/* Catch-up policy of recurrent entries (PSCHED_CATCHUP_*) */
+} psched_arm_attr_t;
+
+typedef struct psched_counters {
+	uint64_t wakeups;	/* Timer expirations processed */
+	uint64_t wakeups_saved;	/* Wakeups avoided by running entries with slack ahead of their deadline */
+	uint64_t arms;		/* Entries armed */
+	uint64_t disarms;	/* Entries disarmed */
+	uint64_t fires;		/* Routines dispatched */
+	uint64_t reschedules;	/* Recurrent entries queued again after firing */
+	uint64_t expired;	/* Entries removed after reaching their expiration */
+	uint64_t timer_updates;	/* Calls to timer_settime() */
+	uint64_t missed;	/* Periods of recurrent entries skipped because the entry fired late */
+	uint64_t lock_wait;	/* Time spent waiting for the event mutex, in nanoseconds */
+	uint64_t queued;	/* Entries currently queued (gauge) */
+} psched_counters_t;
+
+typedef struct psched_latency {
+	uint64_t count;		/* Values recorded */
+	uint64_t sum;		/* Sum of the values recorded, in nanoseconds */
+	uint64_t p50;		/* Percentiles, in nanoseconds (within 1/16 of the actual value) */
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;		/* Largest value recorded, in nanoseconds */
+} psched_latency_t;
+
+typedef struct psched_stats {
+	psched_counters_t counters;
+	psched_latency_t lateness;	/* Time from the entry trigger to the start of its routine */
+	psched_latency_t runtime;	/* Time taken by the routine */
+} psched_stats_t;
+
+typedef struct psched_arm_req {
+	struct timespec trigger;
+	struct timespec step;	/* Zero for non-recurrent entries */
+	struct timespec expire;	/* Zero for entries that never expire */
+	void (*routine) (void *);
+	void *arg;
+} psched_arm_req_t;
+
 typedef struct psched_handler {
 	timer_t timer;
 	int sig;	/* TODO: Handler flags field */
 	int threaded;	/* TODO: Handler flags field */
 	int destroy;	/* TODO: Handler flags field */
 	int fatal;	/* TODO: Handler flags field */
+	int armed;	/* The timer is programmed for the earliest deadline (armed_trigger) */
+	int pollable;	/* Deadlines are programmed on 'fd' and processed by psched_dispatch() */
+	int fd;		/* Descriptor of pollable handlers, readable when some entry is due */
+	int submit;	/* Arms and disarms are queued on 'submitq' (see psched_submit_drain()) */
+	int backend;
+	clockid_t clockid;
+	int now_valid;		/* Set while a wakeup is being processed */
+	pthread_t now_thread;	/* Thread processing the wakeup, the only one using 'now' */
+	struct timespec now;	/* Clock reading of the wakeup being processed */
 	pthread_mutex_t event_mutex;
 	pthread_cond_t event_cond;
+	pthread_mutex_t submit_mutex;	/* Serializes the entry allocations and the handle table on submission mode */
+	pthread_mutex_t timer_mutex;	/* Serializes the timer programming on submission mode */
+	struct psched_submitq submitq;	/* Requests not yet applied to the scheduling queue */
+	uint64_t armed_ns;		/* Deadline currently programmed on the timer, on submission mode (0 if none) */
+	struct psched_epoch epoch;	/* Lock-free readers of the entries (see psched_search()) */
+	struct psched_entry *retired;	/* Released entries, reused once no reader may reference them */
+	struct psched_entry **retired_tail;
+	size_t nretired;
 	struct sigaction sa;
 	struct sigaction sa_old;
-	struct cll_handler *s;
-	struct psched_entry *armed;
+	struct psched_handles handles;
+	struct psched_groups groups;
+	struct mm_pool pool;
+	struct psched_heap heap;
+	struct psched_wheel *wheel;
+	struct psched_exec exec;
+	pthread_attr_t thread_attr;	/* Attributes of the threads created for this handler */
+	struct timespec armed_trigger;	/* Deadline currently programmed on the timer */
+	psched_counters_t counters;
+	int stats;		/* Set while the latency histograms are recorded (see psched_stats_enable()) */
+	struct psched_histogram lateness;
+	struct psched_histogram runtime;
 } psched_t;
 
+/* Sharded handler. Arms are routed to the shard assigned to the calling thread, and the shard is encoded on
+ * the entry id, so disarm and search go straight to it.
+ */
+typedef struct psched_sharded {
+	psched_t **shards;
+	unsigned int nshards;
+	unsigned int next;	/* Next shard to be assigned to a thread */
+	pthread_mutex_t mutex;
+	pthread_key_t key;	/* Shard assigned to the calling thread (index + 1) */
+} psched_sharded_t;
+
 struct psched_entry {
 	pschedid_t id;
 	struct timespec trigger;
 	struct timespec step;
 	struct timespec expire;
+	struct timespec slack;
+	struct timespec deadline;	/* Latest time the entry may fire (trigger + slack), used as the queue key */
+	struct timespec fired;		/* Trigger the routine is being executed for */
+	unsigned int seq;		/* Sequence counter of trigger, step, expire and touch */
+	struct timespec touch;		/* Trigger set by psched_touch(), applied once the entry reaches the queue head */
+	struct timespec rearm_trigger;	/* Reschedule requested while the entry was in progress */
+	struct timespec rearm_step;
+	struct timespec rearm_expire;
 	int expired;		/* TODO: Entry flags field */
 	int in_progress;	/* TODO: Entry flags field */
 	int to_remove;		/* TODO: Entry flags field */
+	int submitted;		/* Arm request not yet drained, so the entry isn't queued */
+	int cancelled;		/* Disarmed on submission mode, hidden until the scheduler removes it */
+	int touched;		/* 'touch' holds a trigger not yet applied to the queue */
+	int rearmed;		/* 'rearm_*' hold a reschedule to apply once the entry is done */
+	int flags;		/* PSCHED_ARM_* */
+	int catchup;		/* PSCHED_CATCHUP_* */
+	uint64_t overrun;	/* Periods missed when the entry last fired (still pending with PSCHED_CATCHUP_ALL) */
 	void (*routine) (void *);
 	void *arg;
+	struct psched_handler *handler;
+	struct exec_work work;	/* Executor work item */
+	size_t heap_pos;	/* Position on the handler heap (1-based, 0 if not queued) */
+	uint64_t wheel_tick;	/* Timing wheel tick (rounded up trigger) */
+	int wheel_slot;		/* Timing wheel bucket (-1 if due) */
+	struct psched_entry *wheel_next;
+	struct psched_entry **wheel_pprev;
+	struct psched_entry *due_next;	/* Next due entry on the batch being processed */
+	struct psched_group *group;	/* Group the entry belongs to (NULL if none) */
+	struct psched_entry *group_next;
+	struct psched_entry **group_pprev;
+	struct psched_submit submit;	/* Arm request, while the entry is on the submission queue */
+	struct psched_submit cancel;	/* Disarm request, while the entry is on the submission queue */
+	int cancel_queued;		/* The disarm request wasn't drained yet */
+	int released;			/* Released while its disarm request was queued, retired once drained */
+	struct psched_entry *retired_next;
+	uint64_t retired_epoch;		/* Epoch the entry was released on */
 };
 
-/* Macros */
-#define psched_val(val) ((struct psched_entry [1]) { { val, } })
-
 /* Prototypes */
+int psched_attr_init(psched_attr_t *attr);
+int psched_arm_attr_init(psched_arm_attr_t *attr);
 psched_t *psched_thread_init(void);
+psched_t *psched_thread_init_ex(const psched_attr_t *attr);
 psched_t *psched_sig_init(int sig);
+psched_t *psched_sig_init_ex(int sig, const psched_attr_t *attr);
+psched_t *psched_fd_init(void);
+psched_t *psched_fd_init_ex(const psched_attr_t *attr);
+int psched_fd(psched_t *handler);
+int psched_dispatch(psched_t *handler, unsigned int max);
+int psched_next_deadline(psched_t *handler, struct timespec *deadline);
 int psched_fatal(psched_t *handler);
+int psched_counters_get(psched_t *handler, psched_counters_t *counters);
+int psched_stats_enable(psched_t *handler, int enable);
+int psched_stats_snapshot(psched_t *handler, psched_stats_t *stats);
+int psched_stats_get(psched_t *handler, psched_stats_t *stats);
+int psched_stats_prometheus(const psched_stats_t *stats, const char *name, char *buf, size_t size);
 int psched_destroy(psched_t *handler);
 void psched_handler_destroy(psched_t *handler);
 pschedid_t psched_timestamp_arm(
@@ -90,13 +267,89 @@ pschedid_t psched_timespec_arm(
 		struct timespec *expire,
 		void (*routine) (void *),
 		void *arg);
+pschedid_t psched_timespec_arm_ex(
+		psched_t *handler,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr);
+pschedid_t psched_timespec_arm_in(
+		psched_t *handler,
+		struct timespec *delay,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr);
+int psched_timespec_arm_batch(
+		psched_t *handler,
+		const psched_arm_req_t *reqs,
+		size_t count,
+		pschedid_t *ids,
+		const psched_arm_attr_t *attr);
 int psched_disarm(psched_t *handler, pschedid_t id);
+int psched_disarm_many(psched_t *handler, const pschedid_t *ids, size_t count);
+int psched_disarm_group(psched_t *handler, uintptr_t group);
+int psched_disarm_all(psched_t *handler);
 int psched_search(
 		psched_t *handler,
 		pschedid_t id,
 		struct timespec *trigger,
 		struct timespec *step,
 		struct timespec *expire);
+int psched_rearm(
+		psched_t *handler,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire);
+int psched_touch(psched_t *handler, pschedid_t id, struct timespec *delay);
+int psched_overrun(psched_t *handler, pschedid_t id);
+void psched_entry_release(psched_t *handler, struct psched_entry *entry);
 int psched_update_timers(psched_t *handler);
+void psched_submit_drain(psched_t *handler);
+void psched_stats_summarize(psched_stats_t *stats, const struct psched_histogram *lateness, const struct psched_histogram *runtime);
+
+/* Sharded handler prototypes */
+psched_sharded_t *psched_sharded_init(unsigned int nshards, const psched_attr_t *attr);
+int psched_sharded_destroy(psched_sharded_t *sharded);
+pschedid_t psched_sharded_arm(
+		psched_sharded_t *sharded,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr);
+pschedid_t psched_sharded_arm_in(
+		psched_sharded_t *sharded,
+		struct timespec *delay,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr);
+int psched_sharded_disarm(psched_sharded_t *sharded, pschedid_t id);
+int psched_sharded_search(
+		psched_sharded_t *sharded,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire);
+int psched_sharded_rearm(
+		psched_sharded_t *sharded,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire);
+int psched_sharded_touch(psched_sharded_t *sharded, pschedid_t id, struct timespec *delay);
+int psched_sharded_overrun(psched_sharded_t *sharded, pschedid_t id);
+int psched_sharded_next_deadline(psched_sharded_t *sharded, struct timespec *deadline);
+int psched_sharded_counters_get(psched_sharded_t *sharded, psched_counters_t *counters);
+int psched_sharded_stats_enable(psched_sharded_t *sharded, int enable);
+int psched_sharded_stats_snapshot(psched_sharded_t *sharded, psched_stats_t *stats);
+int psched_sharded_stats_get(psched_sharded_t *sharded, psched_stats_t *stats);
 
 #endif
@@ -0,0 +1,43 @@
+/**
+ * @file queue.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Scheduling queue interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_QUEUE_H
+#define LIBPSCHED_QUEUE_H
+
+#include <time.h>
+
+#include "psched.h"
+
+/* Prototypes */
+int queue_init(psched_t *handler, const psched_attr_t *attr);
+void queue_destroy(psched_t *handler);
+int queue_insert(psched_t *handler, struct psched_entry *entry);
+void queue_remove(psched_t *handler, struct psched_entry *entry);
+int queue_next(psched_t *handler, struct timespec *deadline);
+struct psched_entry *queue_pop(psched_t *handler, const struct timespec *now);
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file seqcount.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Sequence counter interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_SEQCOUNT_H
+#define LIBPSCHED_SEQCOUNT_H
+
+/* Sequence counters let readers copy data updated by a single writer at a
+ * time without locking. The counter is odd while an update is in progress,
+ * and readers retry if it changed while they were copying.
+ */
+
+/* Prototypes */
+void seqcount_write_begin(unsigned int *seq);
+void seqcount_write_end(unsigned int *seq);
+unsigned int seqcount_read_begin(const unsigned int *seq);
+int seqcount_read_retry(const unsigned int *seq, unsigned int start);
+
+#endif
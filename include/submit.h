@@ -0,0 +1,60 @@
+/**
+ * @file submit.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Submission queue interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LIBPSCHED_SUBMIT_H
+#define LIBPSCHED_SUBMIT_H
+
+#include <stdint.h>
+
+/* Submission request types */
+#define SUBMIT_ARM	1
+#define SUBMIT_DISARM	2
+
+/* Intrusive multi-producer single-consumer queue of arm and disarm requests.
+ * Producers push with a single atomic exchange and never wait on each other
+ * nor on the consumer, which drains the requests in submission order.
+ */
+struct psched_submit {
+	struct psched_submit *next;
+	int type;		/* SUBMIT_* */
+	void *entry;		/* Entry the request refers to (and is embedded on) */
+	uintptr_t group;	/* Group tag of arm requests */
+};
+
+struct psched_submitq {
+	struct psched_submit *head;	/* Last pushed request (producers) */
+	struct psched_submit *tail;	/* Next request to be popped (consumer) */
+	struct psched_submit stub;
+};
+
+/* Prototypes */
+void submit_init(struct psched_submitq *q);
+void submit_push(struct psched_submitq *q, struct psched_submit *node);
+struct psched_submit *submit_pop(struct psched_submitq *q);
+int submit_empty(struct psched_submitq *q);
+
+#endif
@@ -34,8 +34,11 @@
 #include "psched.h"
 
 /* Prototypes */
-int thread_init(psched_t *handler);
+int thread_init(psched_t *handler, const psched_attr_t *attr);
 void thread_destroy(psched_t *handler);
+int thread_attr_custom(const psched_attr_t *attr);
+int thread_attr_init(pthread_attr_t *pattr, const psched_attr_t *attr);
+void thread_lock(psched_t *handler);
 void thread_handler(union sigval si);
 
 #endif
@@ -28,12 +28,15 @@
 #define LIBPSCHED_TIMER_UL_H
 
 #include <signal.h>
+#include <limits.h>
 #include <time.h>
 #include <pthread.h>
 
 #include <sys/time.h>
 #include <sys/types.h>
 
+#include "exec.h"
+
 #ifdef PSCHED_INTERNAL_TIMER_T
 typedef void * timer_t;
 #endif
@@ -69,36 +72,97 @@ struct sigevent {
 #define timer_getoverrun	timer_getoverrun_ul
 #endif
 
-/* Flags for userland timer_*() implementation */
-#define PSCHED_TIMER_UL_THREAD_INIT_FLAG	0x01	/* Timer thread in initialized state */
-#define PSCHED_TIMER_UL_THREAD_ARMED_FLAG	0x02	/* Timer is armed */
-#define PSCHED_TIMER_UL_THREAD_INTR_FLAG	0x04	/* Timer must be interrupted */
-#define PSCHED_TIMER_UL_THREAD_READ_FLAG	0x08	/* A read op on timer is required */
-#define PSCHED_TIMER_UL_THREAD_WRITE_FLAG	0x10	/* A write op on timer is required */
-#define PSCHED_TIMER_UL_THREAD_WAIT_FLAG	0x20	/* Thread exited and waiting to join */
+/* On Linux, timers are backed by timerfd and multiplexed by a single epoll thread */
+#if defined(__linux__) && !defined(PSCHED_TIMER_UL_NO_TIMERFD)
+ #define PSCHED_TIMER_UL_TIMERFD
+#endif
+
+/* Userland timer engines */
+#define PSCHED_TIMER_UL_ENGINE_SERVICE		0	/* Deadline heap served by a single thread (portable fallback) */
+#define PSCHED_TIMER_UL_ENGINE_TIMERFD		1	/* timerfd, multiplexed by the epoll thread */
+
+/* Maximum number of events fetched by each epoll_wait() call */
+#ifndef PSCHED_TIMER_UL_EPOLL_EVENTS
+ #define PSCHED_TIMER_UL_EPOLL_EVENTS		64
+#endif
+
+/* Upper bound of the overrun count */
+#ifndef DELAYTIMER_MAX
+ #define DELAYTIMER_MAX				INT_MAX
+#endif
+
+/* Default stack size of the threads created by the userland timers (0 for system default) */
+#ifndef PSCHED_TIMER_UL_SERVICE_STACKSIZE
+ #define PSCHED_TIMER_UL_SERVICE_STACKSIZE	0
+#endif
+
+/* Timer slots are allocated in pages that never move, bounding the number of timers to PAGES * PAGE_SLOTS */
+#ifndef PSCHED_TIMER_UL_PAGE_BITS
+ #define PSCHED_TIMER_UL_PAGE_BITS		8
+#endif
+#define PSCHED_TIMER_UL_PAGE_SLOTS		(1 << PSCHED_TIMER_UL_PAGE_BITS)
+#ifndef PSCHED_TIMER_UL_PAGES
+ #define PSCHED_TIMER_UL_PAGES			1024
+#endif
+
+/* Clocks served by the service engine */
+#define PSCHED_TIMER_UL_SERVICE_REALTIME	0
+#define PSCHED_TIMER_UL_SERVICE_MONOTONIC	1
+#define PSCHED_TIMER_UL_SERVICES		2
 
 /* Structures */
+struct timer_ul;
+
+struct timer_ul_service {
+	int init;
+	clockid_t clockid;		/* Clock the deadlines are kept on and waited on */
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;		/* Bound to clockid */
+
+	struct timer_ul **heap;		/* Armed timers, by deadline */
+	size_t count;
+	size_t size;
+};
+
+/* SIGEV_THREAD notifications are delivered by a persistent thread per timer. A notification still running
+ * when the next expiration is due holds that one back (which is an overrun if it's still queued when the
+ * one after it is due), but never delays the other timers.
+ */
+struct timer_ul_notify {
+	struct psched_exec exec;	/* Notification thread of the timer (SIGEV_THREAD only) */
+	struct exec_work work;
+	struct sigevent sevp;
+};
+
 struct timer_ul {
 	timer_t id;
-	int flags;
+	size_t slot;			/* Index on the slot table */
+	int engine;
 	clockid_t clockid;
-	struct sigevent sevp;
 
-	struct timespec init_time;	/* Absolute time when first armed */
+	pthread_mutex_t mutex;		/* Serializes the operations on this timer */
+
+	struct timer_ul_notify notify;	/* Notification work item */
+
+	/* Overruns are accounted per delivered notification, as with timer_getoverrun(). Protected by the lock of
+	 * the engine delivering the expirations, along with the timer lock.
+	 */
+	int overruns;			/* Expirations not notified since the last notification was delivered */
+	int overrun;			/* Overruns of the last notification delivered */
 
-	struct timespec rem;
-	struct itimerspec arm;
+	/* Service engine specific (protected by the service lock) */
+	struct timer_ul_service *service;
+	int armed;
+	struct timespec deadline;	/* Next expiration, on the service clock */
+	struct timespec interval;
+	size_t heap_pos;		/* Position on the service heap (1-based, 0 if not queued) */
 
-	int overruns;
+	/* timerfd engine specific */
+	int tfd;
+	unsigned int gen;		/* Validates epoll events against slot reuse */
 
-	/* Thread specific */
-	pthread_t t_id;
-	pthread_cond_t t_cond_h;
-	pthread_cond_t t_cond_p;
-	pthread_mutex_t t_mutex;
-	int t_flags;
-	int wait_pipe[2];
-	fd_set wait_set;
+	struct timer_ul *free_next;	/* Next free slot */
 };
 
 
@@ -112,6 +176,8 @@ int timer_settime_ul(
 	struct itimerspec *old_value);
 int timer_gettime_ul(timer_t timerid, struct itimerspec *curr_value);
 int timer_getoverrun_ul(timer_t timerid);
+int timer_setstacksize_ul(size_t stacksize);
+int timer_setattr_ul(const pthread_attr_t *attr);
 
 #endif
 
@@ -28,11 +28,14 @@
 #ifndef LIBPSCHED_TIMESPEC_H
 #define LIBPSCHED_TIMESPEC_H
 
+#include <stdint.h>
 #include <time.h>
 
 /* Prototypes */
 void timespec_sub(struct timespec *dest, const struct timespec *src);
 void timespec_add(struct timespec *dest, const struct timespec *src);
 int timespec_cmp(const struct timespec *ts1, const struct timespec *ts2);
+uint64_t timespec_to_ns(const struct timespec *ts);
+void timespec_from_ns(struct timespec *ts, uint64_t ns);
 
 #endif
@@ -0,0 +1,65 @@
+/**
+ * @file wheel.h
+ * @brief Portable Scheduler Library (libpsched)
+ *        Hierarchical timing wheel interface header
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LIBPSCHED_WHEEL_H
+#define LIBPSCHED_WHEEL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define PSCHED_WHEEL_LEVELS	4
+#define PSCHED_WHEEL_BITS	6
+#define PSCHED_WHEEL_SLOTS	(1 << PSCHED_WHEEL_BITS)
+#define PSCHED_WHEEL_MASK	(PSCHED_WHEEL_SLOTS - 1)
+
+struct psched_entry;
+
+/* Hashed hierarchical timing wheel. Entries are linked into the bucket of
+ * their tick (entry->wheel_*), so insertion and removal are O(1). Buckets of
+ * the upper levels are cascaded into the lower ones as the wheel turns, and
+ * level 0 buckets are moved to the 'due' list once their tick is reached.
+ */
+struct psched_wheel {
+	struct timespec start;		/* Absolute time of tick 0 */
+	uint64_t tick;			/* Tick length, in nanoseconds */
+	uint64_t now;			/* Last processed tick */
+	size_t count;			/* Entries on buckets (excluding 'due') */
+	uint64_t map[PSCHED_WHEEL_LEVELS];	/* Non-empty bucket bitmaps */
+	struct psched_entry *slots[PSCHED_WHEEL_LEVELS][PSCHED_WHEEL_SLOTS];
+	struct psched_entry *due;
+};
+
+/* Prototypes */
+struct psched_wheel *wheel_init(const struct timespec *start, const struct timespec *tick);
+void wheel_destroy(struct psched_wheel *wheel);
+void wheel_insert(struct psched_wheel *wheel, struct psched_entry *entry);
+void wheel_remove(struct psched_wheel *wheel, struct psched_entry *entry);
+int wheel_next(const struct psched_wheel *wheel, struct timespec *deadline);
+struct psched_entry *wheel_pop(struct psched_wheel *wheel, const struct timespec *now);
+
+#endif
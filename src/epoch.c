@@ -0,0 +1,96 @@
+/**
+ * @file epoch.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Epoch based reclamation interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <string.h>
+#include <stdint.h>
+
+#include "epoch.h"
+
+void epoch_init(struct psched_epoch *epoch) {
+	memset(epoch, 0, sizeof(struct psched_epoch));
+
+	/* Epoch 0 marks free reader slots */
+	epoch->global = 1;
+}
+
+/* Enters a read-side critical section. Returns the reader slot, to be passed to epoch_leave(), or -1 if all
+ * the slots are taken.
+ */
+int epoch_enter(struct psched_epoch *epoch) {
+	uint64_t global = __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST), free = 0;
+	unsigned int i = 0, start = 0;
+	int dummy = 0;
+
+	/* Threads start probing at different slots, based on their stack address */
+	start = (unsigned int) (((uintptr_t) &dummy) >> 12) % PSCHED_EPOCH_READERS;
+
+	for (i = 0; i < PSCHED_EPOCH_READERS; i ++) {
+		struct psched_epoch_reader *reader = &epoch->readers[(start + i) % PSCHED_EPOCH_READERS];
+
+		free = 0;
+
+		if (__atomic_compare_exchange_n(&reader->epoch, &free, global, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			/* The announcement must be visible before any shared pointer is loaded */
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+			return (start + i) % PSCHED_EPOCH_READERS;
+		}
+	}
+
+	return -1;
+}
+
+void epoch_leave(struct psched_epoch *epoch, int slot) {
+	__atomic_store_n(&epoch->readers[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* Retrieves the epoch an object unlinked by the caller is retired with */
+uint64_t epoch_retire(const struct psched_epoch *epoch) {
+	/* The object must be unlinked before the epoch is read */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&epoch->global, __ATOMIC_SEQ_CST);
+}
+
+/* Advances the global epoch and retrieves the oldest epoch some reader may still be in. Objects retired with
+ * an earlier epoch are no longer referenced by any reader. Writers are serialized by the caller.
+ */
+uint64_t epoch_sync(struct psched_epoch *epoch) {
+	uint64_t oldest = 0, entered = 0;
+	unsigned int i = 0;
+
+	oldest = __atomic_add_fetch(&epoch->global, 1, __ATOMIC_SEQ_CST);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for (i = 0; i < PSCHED_EPOCH_READERS; i ++) {
+		if ((entered = __atomic_load_n(&epoch->readers[i].epoch, __ATOMIC_SEQ_CST)) && (entered < oldest))
+			oldest = entered;
+	}
+
+	return oldest;
+}
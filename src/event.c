@@ -34,30 +34,218 @@
 
 #include <sys/time.h>
 
+#include "exec.h"
+#include "histogram.h"
 #include "psched.h"
+#include "queue.h"
+#include "seqcount.h"
+#include "thread.h"
 #include "timespec.h"
 
-void event_process(psched_t *handler) {
-	struct psched_entry *entry = NULL;
-	struct timespec tp_now;
+/* Statics */
+static void _event_advance(struct psched_entry *entry, uint64_t periods) {
+	struct timespec advance;
+
+	timespec_from_ns(&advance, periods * timespec_to_ns(&entry->step));
+
+	seqcount_write_begin(&entry->seq);
+	timespec_add(&entry->trigger, &advance);
+	seqcount_write_end(&entry->seq);
+}
+
+static int _event_prepare(struct psched_entry *entry, const struct timespec *tp_now, uint64_t *missed) {
+	struct timespec late;
+
+	/* Skip entries that were disarmed while their batch was being processed (on submission mode, the disarm
+	 * request may not have been drained yet)
+	 */
+	if (entry->to_remove || __atomic_load_n(&entry->cancelled, __ATOMIC_RELAXED))
+		return 0;
+
+	/* Validate if entry isn't expired */
+	if ((entry->expire.tv_sec || entry->expire.tv_nsec) && (timespec_cmp(tp_now, &entry->expire) >= 0)) {
+		/* TODO: Expiration checks should be performed after step addition */
+		entry->expired = 1;
+	}
+
+	/* If no step defined or if expired, set it to be removed */
+	if (entry->expired) {
+		__atomic_store_n(&entry->to_remove, 1, __ATOMIC_RELAXED);
+
+		return 0;
+	}
+
+	if (timespec_cmp(tp_now, &entry->trigger) < 0)
+		return 0;
+
+	memcpy(&entry->fired, &entry->trigger, sizeof(struct timespec));
+
+	/* If the entry is recurrent... */
+	if ((entry->step.tv_sec || entry->step.tv_nsec)) {
+		/* Whole periods that went by since the trigger, computed at once however late the entry is */
+		memcpy(&late, tp_now, sizeof(struct timespec));
+		timespec_sub(&late, &entry->trigger);
+
+		entry->overrun = timespec_to_ns(&late) / timespec_to_ns(&entry->step);
+
+		switch (entry->catchup) {
+			case PSCHED_CATCHUP_ALL: {
+				/* Move a single period, so the entry is due again until it catches up */
+				_event_advance(entry, 1);
+
+				return 1;
+			}
+			case PSCHED_CATCHUP_SKIP: {
+				if (entry->overrun) {
+					*missed += entry->overrun + 1;
+
+					_event_advance(entry, entry->overrun + 1);
+
+					return 0;
+				}
+
+				break;
+			}
+		}
+
+		*missed += entry->overrun;
+
+		/* Move to the first period after the current time */
+		_event_advance(entry, entry->overrun + 1);
+	} else {
+		/* Otherwise, mark it to be removed from scheduling list */
+		__atomic_store_n(&entry->to_remove, 1, __ATOMIC_RELAXED);
+	}
+
+	/* The entry routine shall be executed */
+	return 1;
+}
+
+/* Nanoseconds from 'start' to 'end' (0 if 'end' comes first) */
+static uint64_t _event_elapsed(const struct timespec *start, const struct timespec *end) {
+	struct timespec elapsed;
+
+	memcpy(&elapsed, end, sizeof(struct timespec));
+	timespec_sub(&elapsed, start);
+
+	return timespec_to_ns(&elapsed);
+}
+
+static void _event_run(psched_t *handler, struct psched_entry *entry) {
+	struct timespec start, end;
+
+	/* Routines are only timed while the latency histograms are being recorded */
+	if (!__atomic_load_n(&handler->stats, __ATOMIC_RELAXED)) {
+		entry->routine(entry->arg);
+
+		return;
+	}
+
+	clock_gettime(handler->clockid, &start);
+
+	entry->routine(entry->arg);
+
+	clock_gettime(handler->clockid, &end);
+
+	histogram_record(&handler->lateness, _event_elapsed(&entry->fired, &start));
+	histogram_record(&handler->runtime, _event_elapsed(&start, &end));
+}
+
+static void _event_finish(psched_t *handler, struct psched_entry *entry) {
+	entry->in_progress = 0;
+
+	/* Apply the reschedule requested while the entry was in progress, which revives fired or expired entries */
+	if (entry->rearmed) {
+		seqcount_write_begin(&entry->seq);
+		memcpy(&entry->trigger, &entry->rearm_trigger, sizeof(struct timespec));
+		memcpy(&entry->step, &entry->rearm_step, sizeof(struct timespec));
+		memcpy(&entry->expire, &entry->rearm_expire, sizeof(struct timespec));
+		seqcount_write_end(&entry->seq);
+
+		entry->rearmed = 0;
+		__atomic_store_n(&entry->to_remove, 0, __ATOMIC_RELAXED);
+		entry->expired = 0;
+		entry->overrun = 0;
+	}
+
+	/* Remove the entry or queue it again with its updated trigger */
+	if (entry->to_remove) {
+		if (entry->expired)
+			handler->counters.expired ++;
+
+		psched_entry_release(handler, entry);
+	} else if (__atomic_load_n(&entry->cancelled, __ATOMIC_RELAXED)) {
+		/* Disarmed on submission mode while in progress. The entry is retired once its disarm request
+		 * is drained.
+		 */
+		psched_entry_release(handler, entry);
+
+		handler->counters.disarms ++;
+	} else if (queue_insert(handler, entry) < 0) {
+		handler->fatal = 1;
+		abort();
+	} else {
+		handler->counters.reschedules ++;
+	}
+}
+
+static void _event_dispatch(void *arg) {
+	struct psched_entry *entry = arg;
+	psched_t *handler = entry->handler;
+
+	/* Executed by the executor threads */
+	_event_run(handler, entry);
+
+	thread_lock(handler);
+
+	_event_finish(handler, entry);
+
+	/* A handler being destroyed is waiting for the entries in progress to complete */
+	if (handler->destroy) {
+		pthread_cond_signal(&handler->event_cond);
+	} else if (psched_update_timers(handler) < 0) {
+		handler->fatal = 1;
+		abort();
+	}
+
+	pthread_mutex_unlock(&handler->event_mutex);
+}
+
+/* Processes the due entries, up to 'max' of them (all if 0) */
+int event_process(psched_t *handler, unsigned int max) {
+	struct psched_entry *entry = NULL, *due = NULL, **due_tail = &due, *next = NULL;
+	struct timespec tp_now, *saved = NULL;
 	struct timeval tv;
+	uint64_t missed = 0;
+	unsigned int popped = 0;
+	int dispatched = 0;
 
 	/* Lock event mutex */
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+	if (handler->threaded) thread_lock(handler);
+
+	/* The timer expired, so nothing is armed at this point */
+	handler->armed = 0;
 
 	/* If there's an indication to destroy the handler, don't pass from this point on... */
 	if (handler->destroy) {
-		handler->armed = NULL;
-
 		if (handler->threaded) pthread_cond_signal(&handler->event_cond);
 
 		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-		return;
+		return 0;
 	}
 
+	/* Apply the submitted requests, so the entries due by now are popped along with the others */
+	if (handler->submit) psched_submit_drain(handler);
+
 	/* Get current time */
-	if (clock_gettime(CLOCK_REALTIME, &tp_now) < 0) {
+	if (clock_gettime(handler->clockid, &tp_now) < 0) {
+		/* Only the wall clock can be approximated */
+		if (handler->clockid != CLOCK_REALTIME) {
+			handler->fatal = 1;
+			abort();
+		}
+
 		if (gettimeofday(&tv, NULL) < 0) {
 			tp_now.tv_sec = tv.tv_sec;
 			tp_now.tv_nsec = tv.tv_usec * 1000;
@@ -67,69 +255,92 @@ void event_process(psched_t *handler) {
 		}
 	}
 
-	entry = handler->armed;
+	/* Entries armed with a relative delay by the routines run on this thread are resolved against this
+	 * reading. Other threads always read the clock.
+	 */
+	memcpy(&handler->now, &tp_now, sizeof(struct timespec));
+	handler->now_thread = pthread_self();
+	handler->now_valid = 1;
+
+	handler->counters.wakeups ++;
+
+	/* Collect every entry that is due in a single pass, marking them as 'in progress' */
+	while ((!max || (popped ++ < max)) && (entry = queue_pop(handler, &tp_now))) {
+		/* Entries that run ahead of their deadline would have required a wakeup of their own, shared
+		 * by those with the same deadline. Only the heap pops entries ahead of their deadline (the
+		 * timing wheel places them on the tick their deadline rounds up to), and it pops them in
+		 * deadline order, so the entries sharing one are popped back to back.
+		 */
+		if ((timespec_cmp(&entry->deadline, &tp_now) > 0) && (!saved || timespec_cmp(&entry->deadline, saved))) {
+			handler->counters.wakeups_saved ++;
+			saved = &entry->deadline;
+		}
 
-	/* If there's an armed entry, mark it as 'in progress' and start processing it */
-	if (entry) {
 		entry->in_progress = 1;
+		entry->due_next = NULL;
 
-		/* No armed entry */
-		handler->armed = NULL;
+		*due_tail = entry;
+		due_tail = &entry->due_next;
+	}
 
-		/* Unlock event mutex to maximize parallel processing of entries */
-		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+	/* Unlock event mutex to maximize parallel processing of entries */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-		/* Validate if entry isn't expired */
-		if ((entry->expire.tv_sec || entry->expire.tv_nsec) && (timespec_cmp(&tp_now, &entry->expire) >= 0)) {
-			/* TODO: Expiration checks should be performed after step addition */
-			entry->expired = 1;
+	for (due_tail = &due; (entry = *due_tail); ) {
+		if (!_event_prepare(entry, &tp_now, &missed)) {
+			due_tail = &entry->due_next;
+			continue;
 		}
 
-		/* If no step defined or if expired, set it to be removed */
-		if (entry->expired) {
-			entry->to_remove = 1;
-		} else if ((timespec_cmp(&tp_now, &entry->trigger) >= 0)) {
-			/* If the entry is recurrent... */
-			if ((entry->step.tv_sec || entry->step.tv_nsec)) {
-				/* Add step to trigger while its lesser than current time */
-				do timespec_add(&entry->trigger, &entry->step);
-				while (timespec_cmp(&tp_now, &entry->trigger) >= 0);
-
-			} else {
-				/* Otherwise, mark it to be removed from scheduling list */
-				entry->to_remove = 1;
-			}
+		dispatched ++;
 
-			/* Execute the entry routine */
-			entry->routine(entry->arg);
+		/* Execute the entry routine here if there's no executor or if it's meant to run inline */
+		if (!handler->exec.nthreads || (entry->flags & PSCHED_ARM_INLINE)) {
+			_event_run(handler, entry);
 
+			/* The routine may have taken a while, so the next one gets a fresh reading */
+			if (clock_gettime(handler->clockid, &handler->now) < 0)
+				handler->now_valid = 0;
+
+			due_tail = &entry->due_next;
+			continue;
 		}
 
-		if (entry->to_remove)
-			handler->s->del(handler->s, entry);
+		/* Otherwise hand it over to the executor, which completes it on its own */
+		*due_tail = entry->due_next;
 
-		/* Acquire lock again as we're managing critical regions */
-		if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+		entry->work.routine = &_event_dispatch;
+		entry->work.arg = entry;
 
-		entry->in_progress = 0;
+		exec_submit(&handler->exec, &entry->work);
 	}
 
-	/* Since the lock may have been released before the last handler->destroy check, we must do
-	 * it again here.
-	 */
+	/* Acquire lock again as we're managing critical regions */
+	if (handler->threaded) thread_lock(handler);
 
-	/* If there's an indication to destroy the handler, don't pass from this point on... */
-	if (handler->destroy) {
-		handler->armed = NULL;
+	/* The wakeup is over, so the cached clock reading is stale from this point on */
+	handler->now_valid = 0;
+
+	handler->counters.fires += dispatched;
+	handler->counters.missed += missed;
+
+	/* Remove the processed entries or queue them again with their updated triggers, in bulk */
+	for (entry = due; entry; entry = next) {
+		next = entry->due_next;
 
+		_event_finish(handler, entry);
+	}
+
+	/* Since the lock was released while processing the entries, we must check for destruction again */
+	if (handler->destroy) {
 		if (handler->threaded) pthread_cond_signal(&handler->event_cond);
 
 		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-		return;
+		return dispatched;
 	}
 
-	/* Update timers */
+	/* Update timers, once for the whole batch */
 	if (psched_update_timers(handler) < 0) {
 		handler->fatal = 1;
 		abort();
@@ -137,5 +348,7 @@ void event_process(psched_t *handler) {
 
 	/* Unlock event mutex */
 	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return dispatched;
 }
 
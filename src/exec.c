@@ -0,0 +1,367 @@
+/**
+ * @file exec.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Executor interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "exec.h"
+#include "mm.h"
+
+/* Statics */
+static void *_exec_worker(void *arg) {
+	struct exec_thread *thread = arg;
+	struct psched_exec *exec = thread->exec;
+	struct exec_work *work = NULL;
+
+	pthread_mutex_lock(&exec->mutex);
+
+	for (;;) {
+		/* Wait for work, or for the executor to be stopped */
+		while (!exec->head && !exec->stop)
+			pthread_cond_wait(&exec->cond, &exec->mutex);
+
+		/* Pending work is always drained before stopping */
+		if (!(work = exec->head))
+			break;
+
+		if (!(exec->head = work->next))
+			exec->tail = &exec->head;
+
+		work->queued = 0;
+		thread->current = work;
+
+		/* Run the work item with the executor unlocked. The item may be released by its own routine, so
+		 * it must not be accessed after this point.
+		 */
+		pthread_mutex_unlock(&exec->mutex);
+
+		work->routine(work->arg);
+
+		pthread_mutex_lock(&exec->mutex);
+
+		thread->current = NULL;
+		pthread_cond_broadcast(&exec->done);
+	}
+
+	pthread_mutex_unlock(&exec->mutex);
+
+	return NULL;
+}
+
+static struct exec_work *_exec_deque_take(struct exec_thread *thread, int tail) {
+	struct exec_work *work = NULL;
+
+	pthread_mutex_lock(&thread->lock);
+
+	if ((work = tail ? thread->tail : thread->head)) {
+		if (work->prev)
+			work->prev->next = work->next;
+		else
+			thread->head = work->next;
+
+		if (work->next)
+			work->next->prev = work->prev;
+		else
+			thread->tail = work->prev;
+	}
+
+	pthread_mutex_unlock(&thread->lock);
+
+	return work;
+}
+
+static int _exec_deque_remove(struct exec_thread *thread, struct exec_work *work) {
+	struct exec_work *iter = NULL;
+
+	pthread_mutex_lock(&thread->lock);
+
+	/* The item may have been taken by a worker already */
+	for (iter = thread->head; iter && (iter != work); iter = iter->next);
+
+	if (iter) {
+		if (work->prev)
+			work->prev->next = work->next;
+		else
+			thread->head = work->next;
+
+		if (work->next)
+			work->next->prev = work->prev;
+		else
+			thread->tail = work->prev;
+	}
+
+	pthread_mutex_unlock(&thread->lock);
+
+	return iter ? 0 : -1;
+}
+
+static void *_exec_worker_steal(void *arg) {
+	struct exec_thread *thread = arg;
+	struct psched_exec *exec = thread->exec;
+	struct exec_work *work = NULL;
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&exec->mutex);
+
+	for (;;) {
+		/* Wait for work, or for the executor to be stopped */
+		while (!exec->pending && !exec->stop)
+			pthread_cond_wait(&exec->cond, &exec->mutex);
+
+		/* Pending work is always drained before stopping */
+		if (!exec->pending)
+			break;
+
+		/* Claim an item. The deques are accessed with the executor unlocked. */
+		exec->pending --;
+
+		pthread_mutex_unlock(&exec->mutex);
+
+		/* Take the oldest item of our own deque, or steal the newest item of another thread, so
+		 * items queued behind a long running routine are picked up by the idle threads.
+		 */
+		if (!(work = _exec_deque_take(thread, 0))) {
+			for (i = 1; i < exec->nthreads; i ++) {
+				if ((work = _exec_deque_take(&exec->threads[(thread - exec->threads + i) % exec->nthreads], 1)))
+					break;
+			}
+		}
+
+		pthread_mutex_lock(&exec->mutex);
+
+		if (!work) {
+			/* The claimed item was cancelled meanwhile */
+			if (exec->orphaned) {
+				exec->orphaned --;
+				continue;
+			}
+
+			/* Otherwise it was queued on a deque already scanned, while another thread took the item
+			 * found there. The claim is restored and the deques scanned again.
+			 */
+			exec->pending ++;
+			continue;
+		}
+
+		work->queued = 0;
+		thread->current = work;
+
+		/* Run the work item with the executor unlocked. The item may be released by its own routine, so
+		 * it must not be accessed after this point.
+		 */
+		pthread_mutex_unlock(&exec->mutex);
+
+		work->routine(work->arg);
+
+		pthread_mutex_lock(&exec->mutex);
+
+		thread->current = NULL;
+		pthread_cond_broadcast(&exec->done);
+	}
+
+	pthread_mutex_unlock(&exec->mutex);
+
+	return NULL;
+}
+
+/* API */
+int exec_init(struct psched_exec *exec, unsigned int nthreads, int flags, const pthread_attr_t *attr) {
+	int errsv = 0;
+
+	memset(exec, 0, sizeof(struct psched_exec));
+
+	exec->tail = &exec->head;
+	exec->flags = flags;
+
+	if (!(exec->threads = mm_alloc(sizeof(struct exec_thread) * nthreads)))
+		return -1;
+
+	memset(exec->threads, 0, sizeof(struct exec_thread) * nthreads);
+
+	if ((errsv = pthread_mutex_init(&exec->mutex, NULL)))
+		goto _init_failure_mutex;
+
+	if ((errsv = pthread_cond_init(&exec->cond, NULL)))
+		goto _init_failure_cond;
+
+	if ((errsv = pthread_cond_init(&exec->done, NULL)))
+		goto _init_failure_done;
+
+	for (exec->nthreads = 0; exec->nthreads < nthreads; exec->nthreads ++) {
+		exec->threads[exec->nthreads].exec = exec;
+
+		pthread_mutex_init(&exec->threads[exec->nthreads].lock, NULL);
+
+		if ((errsv = pthread_create(&exec->threads[exec->nthreads].id, attr, (flags & EXEC_STEAL) ? &_exec_worker_steal : &_exec_worker, &exec->threads[exec->nthreads]))) {
+			pthread_mutex_destroy(&exec->threads[exec->nthreads].lock);
+
+			/* Stop the threads created so far */
+			exec_destroy(exec);
+
+			errno = errsv;
+
+			return -1;
+		}
+	}
+
+	/* All good */
+	return 0;
+
+_init_failure_done:
+	pthread_cond_destroy(&exec->cond);
+
+_init_failure_cond:
+	pthread_mutex_destroy(&exec->mutex);
+
+_init_failure_mutex:
+	mm_free(exec->threads);
+
+	errno = errsv;
+
+	return -1;
+}
+
+void exec_destroy(struct psched_exec *exec) {
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&exec->mutex);
+	exec->stop = 1;
+	pthread_cond_broadcast(&exec->cond);
+	pthread_mutex_unlock(&exec->mutex);
+
+	for (i = 0; i < exec->nthreads; i ++) {
+		pthread_join(exec->threads[i].id, NULL);
+		pthread_mutex_destroy(&exec->threads[i].lock);
+	}
+
+	pthread_cond_destroy(&exec->done);
+	pthread_cond_destroy(&exec->cond);
+	pthread_mutex_destroy(&exec->mutex);
+
+	mm_free(exec->threads);
+
+	memset(exec, 0, sizeof(struct psched_exec));
+}
+
+/* Queues a work item. Returns -1 (EBUSY) if the item is already queued. */
+int exec_submit(struct psched_exec *exec, struct exec_work *work) {
+	pthread_mutex_lock(&exec->mutex);
+
+	if (work->queued) {
+		pthread_mutex_unlock(&exec->mutex);
+
+		errno = EBUSY;
+
+		return -1;
+	}
+
+	work->queued = 1;
+	work->next = NULL;
+
+	if (exec->flags & EXEC_STEAL) {
+		/* Spread the items over the deques */
+		work->owner = &exec->threads[exec->next ++ % exec->nthreads];
+
+		pthread_mutex_lock(&work->owner->lock);
+
+		if ((work->prev = work->owner->tail))
+			work->owner->tail->next = work;
+		else
+			work->owner->head = work;
+
+		work->owner->tail = work;
+
+		pthread_mutex_unlock(&work->owner->lock);
+
+		exec->pending ++;
+	} else {
+		*exec->tail = work;
+		exec->tail = &work->next;
+	}
+
+	pthread_cond_signal(&exec->cond);
+
+	pthread_mutex_unlock(&exec->mutex);
+
+	return 0;
+}
+
+/* Removes a work item from the queue, if it's still waiting there, and waits for it to complete if it's
+ * being executed by another thread. The work item can be released after this call returns.
+ */
+void exec_cancel(struct psched_exec *exec, struct exec_work *work) {
+	struct exec_work **prev = NULL;
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&exec->mutex);
+
+	if (work->queued && (exec->flags & EXEC_STEAL)) {
+		/* If the item was already taken from its deque, a worker is about to run it */
+		while (work->queued && (_exec_deque_remove(work->owner, work) < 0))
+			pthread_cond_wait(&exec->done, &exec->mutex);
+
+		/* Release the claim on the item. If a worker already holds it, the worker is told it was
+		 * cancelled, once it finds no item.
+		 */
+		if (work->queued) {
+			if (exec->pending)
+				exec->pending --;
+			else
+				exec->orphaned ++;
+		}
+
+		work->queued = 0;
+	}
+
+	for (i = 0; i < exec->nthreads; ) {
+		/* Wait if another thread is executing this work item */
+		if ((exec->threads[i].current == work) && !pthread_equal(exec->threads[i].id, pthread_self())) {
+			pthread_cond_wait(&exec->done, &exec->mutex);
+
+			i = 0;
+
+			continue;
+		}
+
+		i ++;
+	}
+
+	for (prev = &exec->head; work->queued && *prev; prev = &(*prev)->next) {
+		if (*prev != work)
+			continue;
+
+		if (!(*prev = work->next))
+			exec->tail = prev;
+
+		work->queued = 0;
+
+		break;
+	}
+
+	pthread_mutex_unlock(&exec->mutex);
+}
+
@@ -0,0 +1,80 @@
+/**
+ * @file fd.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Pollable descriptor interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+ #include <sys/timerfd.h>
+#endif
+
+#include "fd.h"
+#include "psched.h"
+
+/* Handlers on the pollable mode have no timer of their own. The deadline is programmed on a timerfd, which the
+ * caller watches for readability and then calls psched_dispatch().
+ */
+int fd_init(psched_t *handler) {
+#ifdef __linux__
+	if ((handler->fd = timerfd_create(handler->clockid, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		return -1;
+
+	return 0;
+#else
+	errno = ENOTSUP;
+
+	return -1;
+#endif
+}
+
+void fd_destroy(psched_t *handler) {
+	close(handler->fd);
+
+	handler->fd = -1;
+}
+
+int fd_settime(psched_t *handler, const struct itimerspec *its) {
+#ifdef __linux__
+	return timerfd_settime(handler->fd, TFD_TIMER_ABSTIME, its, NULL);
+#else
+	errno = ENOTSUP;
+
+	return -1;
+#endif
+}
+
+/* Consumes the pending expirations, so the descriptor is no longer readable until the next deadline */
+void fd_clear(psched_t *handler) {
+	uint64_t expirations = 0;
+
+	while (read(handler->fd, &expirations, sizeof(expirations)) < 0) {
+		if (errno != EINTR)
+			break;
+	}
+}
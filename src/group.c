@@ -0,0 +1,170 @@
+/**
+ * @file group.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Entry group interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "group.h"
+#include "mm.h"
+#include "psched.h"
+
+/* Statics */
+static size_t _group_hash(uintptr_t tag, size_t size) {
+	uint32_t h = (uint32_t) (tag ^ (tag >> 16));
+
+	if (sizeof(uintptr_t) > 4)
+		h ^= (uint32_t) ((uint64_t) tag >> 32);
+
+	return (h * 0x9e3779b1U) & (size - 1);
+}
+
+static int _group_rehash(struct psched_groups *groups) {
+	struct psched_group **buckets = NULL, *group = NULL;
+	size_t i = 0, pos = 0;
+
+	if (!(buckets = mm_alloc(sizeof(struct psched_group *) * groups->size * 2)))
+		return -1;
+
+	memset(buckets, 0, sizeof(struct psched_group *) * groups->size * 2);
+
+	for (i = 0; i < groups->size; i ++) {
+		while ((group = groups->buckets[i])) {
+			groups->buckets[i] = group->next;
+
+			pos = _group_hash(group->tag, groups->size * 2);
+
+			group->next = buckets[pos];
+			buckets[pos] = group;
+		}
+	}
+
+	mm_free(groups->buckets);
+
+	groups->buckets = buckets;
+	groups->size *= 2;
+
+	return 0;
+}
+
+/* API */
+int group_init(struct psched_groups *groups) {
+	memset(groups, 0, sizeof(struct psched_groups));
+
+	if (mm_pool_init(&groups->pool, sizeof(struct psched_group), 0) < 0)
+		return -1;
+
+	if (!(groups->buckets = mm_alloc(sizeof(struct psched_group *) * 16))) {
+		mm_pool_destroy(&groups->pool);
+		return -1;
+	}
+
+	memset(groups->buckets, 0, sizeof(struct psched_group *) * 16);
+
+	groups->size = 16;
+
+	return 0;
+}
+
+void group_destroy(struct psched_groups *groups) {
+	mm_free(groups->buckets);
+	mm_pool_destroy(&groups->pool);
+
+	memset(groups, 0, sizeof(struct psched_groups));
+}
+
+struct psched_group *group_lookup(const struct psched_groups *groups, uintptr_t tag) {
+	struct psched_group *group = NULL;
+
+	for (group = groups->buckets[_group_hash(tag, groups->size)]; group; group = group->next) {
+		if (group->tag == tag)
+			break;
+	}
+
+	return group;
+}
+
+int group_add(struct psched_groups *groups, struct psched_entry *entry, uintptr_t tag) {
+	struct psched_group *group = NULL;
+	size_t pos = 0;
+
+	/* Create the group on its first member */
+	if (!(group = group_lookup(groups, tag))) {
+		/* Keep the buckets short */
+		if ((groups->count >= (groups->size * 2)) && (_group_rehash(groups) < 0))
+			return -1;
+
+		if (!(group = mm_pool_alloc(&groups->pool)))
+			return -1;
+
+		pos = _group_hash(tag, groups->size);
+
+		group->tag = tag;
+		group->entries = NULL;
+		group->next = groups->buckets[pos];
+		groups->buckets[pos] = group;
+
+		groups->count ++;
+	}
+
+	/* Link the entry at the head of the group */
+	if ((entry->group_next = group->entries))
+		group->entries->group_pprev = &entry->group_next;
+
+	entry->group_pprev = &group->entries;
+	group->entries = entry;
+	entry->group = group;
+
+	return 0;
+}
+
+void group_del(struct psched_groups *groups, struct psched_entry *entry) {
+	struct psched_group *group = entry->group, **pgroup = NULL;
+
+	if (!group)
+		return;
+
+	/* Unlink the entry */
+	if ((*entry->group_pprev = entry->group_next))
+		entry->group_next->group_pprev = entry->group_pprev;
+
+	entry->group = NULL;
+	entry->group_next = NULL;
+	entry->group_pprev = NULL;
+
+	if (group->entries)
+		return;
+
+	/* Release the group with its last member */
+	for (pgroup = &groups->buckets[_group_hash(group->tag, groups->size)]; *pgroup != group; pgroup = &(*pgroup)->next);
+
+	*pgroup = group->next;
+
+	mm_pool_free(&groups->pool, group);
+
+	groups->count --;
+}
+
@@ -0,0 +1,151 @@
+/**
+ * @file handle.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Entry handle table interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "handle.h"
+#include "mm.h"
+
+/* API */
+int handle_init(struct psched_handles *handles, size_t size) {
+	memset(handles, 0, sizeof(struct psched_handles));
+
+	if (!size)
+		size = 16;
+
+	if (!(handles->slots = mm_alloc(sizeof(struct psched_handle) * size)))
+		return -1;
+
+	handles->size = size;
+
+	return 0;
+}
+
+void handle_destroy(struct psched_handles *handles) {
+	while (handles->nretired)
+		mm_free(handles->retired[-- handles->nretired]);
+
+	mm_free(handles->slots);
+
+	memset(handles, 0, sizeof(struct psched_handles));
+}
+
+uintptr_t handle_alloc(struct psched_handles *handles, struct psched_entry *entry) {
+	struct psched_handle *slots = NULL;
+	size_t slot = 0;
+
+	if (handles->free) {
+		/* Reuse a released slot */
+		slot = handles->free - 1;
+		handles->free = handles->slots[slot].next_free;
+	} else {
+		/* The slot index must fit on the identifier */
+		if (handles->used >= PSCHED_HANDLE_SLOT_MASK) {
+			errno = ENOMEM;
+			return (uintptr_t) -1;
+		}
+
+		/* Grow the table if it's full. The current one is kept, as readers may still be walking it. */
+		if (handles->used == handles->size) {
+			if (!(slots = mm_alloc(sizeof(struct psched_handle) * handles->size * 2)))
+				return (uintptr_t) -1;
+
+			memcpy(slots, handles->slots, sizeof(struct psched_handle) * handles->size);
+
+			handles->retired[handles->nretired ++] = handles->slots;
+			handles->size *= 2;
+
+			__atomic_store_n(&handles->slots, slots, __ATOMIC_RELEASE);
+		}
+
+		slot = handles->used;
+
+		handles->slots[slot].gen = 1;
+
+		/* Publish the slot only once it's initialized */
+		__atomic_store_n(&handles->used, slot + 1, __ATOMIC_RELEASE);
+	}
+
+	__atomic_store_n(&handles->slots[slot].entry, entry, __ATOMIC_RELEASE);
+	handles->slots[slot].next_free = 0;
+
+	handles->count ++;
+
+	return (handles->slots[slot].gen << PSCHED_HANDLE_SLOT_BITS) | slot;
+}
+
+struct psched_entry *handle_lookup(const struct psched_handles *handles, uintptr_t id) {
+	size_t slot = id & PSCHED_HANDLE_SLOT_MASK, used = 0;
+	const struct psched_handle *slots = NULL;
+
+	/* The watermark is loaded first, so the table holds at least as many slots */
+	used = __atomic_load_n(&handles->used, __ATOMIC_ACQUIRE);
+	slots = __atomic_load_n(&handles->slots, __ATOMIC_ACQUIRE);
+
+	if ((slot >= used) || (__atomic_load_n(&slots[slot].gen, __ATOMIC_ACQUIRE) != ((id >> PSCHED_HANDLE_SLOT_BITS) & PSCHED_HANDLE_GEN_MASK)))
+		return NULL;
+
+	return __atomic_load_n(&slots[slot].entry, __ATOMIC_ACQUIRE);
+}
+
+/* Checks if two identifiers refer to the same slot and generation, regardless of their shard */
+int handle_match(uintptr_t id1, uintptr_t id2) {
+	return !((id1 ^ id2) & (((uintptr_t) -1) >> PSCHED_HANDLE_SHARD_BITS));
+}
+
+void handle_release(struct psched_handles *handles, uintptr_t id) {
+	size_t slot = id & PSCHED_HANDLE_SLOT_MASK;
+	uintptr_t gen = 0;
+
+	if (!handle_lookup(handles, id))
+		return;
+
+	__atomic_store_n(&handles->slots[slot].entry, NULL, __ATOMIC_RELEASE);
+
+	/* Invalidate any identifier pointing to this slot. Generation 0 is never used. */
+	if (!(gen = (handles->slots[slot].gen + 1) & PSCHED_HANDLE_GEN_MASK))
+		gen = 1;
+
+	__atomic_store_n(&handles->slots[slot].gen, gen, __ATOMIC_RELEASE);
+
+	handles->slots[slot].next_free = handles->free;
+	handles->free = slot + 1;
+
+	handles->count --;
+}
+
+/* Iterates over the registered entries. 'pos' shall be initialized to 0. */
+struct psched_entry *handle_iterate(const struct psched_handles *handles, size_t *pos) {
+	while (*pos < handles->used) {
+		if (handles->slots[(*pos) ++].entry)
+			return handles->slots[(*pos) - 1].entry;
+	}
+
+	return NULL;
+}
+
@@ -0,0 +1,149 @@
+/**
+ * @file heap.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Deadline ordered priority queue interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include "heap.h"
+#include "mm.h"
+#include "psched.h"
+#include "timespec.h"
+
+/* Statics */
+static void _heap_set(struct psched_heap *heap, size_t i, struct psched_entry *entry) {
+	heap->nodes[i] = entry;
+	entry->heap_pos = i + 1;
+}
+
+static void _heap_up(struct psched_heap *heap, size_t i) {
+	struct psched_entry *entry = heap->nodes[i];
+	size_t parent = 0;
+
+	while (i) {
+		parent = (i - 1) / 2;
+
+		if (timespec_cmp(&heap->nodes[parent]->deadline, &entry->deadline) <= 0)
+			break;
+
+		_heap_set(heap, i, heap->nodes[parent]);
+
+		i = parent;
+	}
+
+	_heap_set(heap, i, entry);
+}
+
+static void _heap_down(struct psched_heap *heap, size_t i) {
+	struct psched_entry *entry = heap->nodes[i];
+	size_t child = 0;
+
+	for (;;) {
+		child = (i * 2) + 1;
+
+		if (child >= heap->count)
+			break;
+
+		/* Pick the earliest of both children */
+		if (((child + 1) < heap->count) && (timespec_cmp(&heap->nodes[child + 1]->deadline, &heap->nodes[child]->deadline) < 0))
+			child ++;
+
+		if (timespec_cmp(&entry->deadline, &heap->nodes[child]->deadline) <= 0)
+			break;
+
+		_heap_set(heap, i, heap->nodes[child]);
+
+		i = child;
+	}
+
+	_heap_set(heap, i, entry);
+}
+
+/* API */
+int heap_init(struct psched_heap *heap, size_t size) {
+	memset(heap, 0, sizeof(struct psched_heap));
+
+	if (!size)
+		size = 16;
+
+	if (!(heap->nodes = mm_alloc(sizeof(struct psched_entry *) * size)))
+		return -1;
+
+	heap->size = size;
+
+	return 0;
+}
+
+void heap_destroy(struct psched_heap *heap) {
+	mm_free(heap->nodes);
+
+	memset(heap, 0, sizeof(struct psched_heap));
+}
+
+int heap_insert(struct psched_heap *heap, struct psched_entry *entry) {
+	struct psched_entry **nodes = NULL;
+
+	/* Grow the node array if it's full */
+	if (heap->count == heap->size) {
+		if (!(nodes = mm_realloc(heap->nodes, sizeof(struct psched_entry *) * heap->size * 2)))
+			return -1;
+
+		heap->nodes = nodes;
+		heap->size *= 2;
+	}
+
+	heap->nodes[heap->count ++] = entry;
+
+	_heap_up(heap, heap->count - 1);
+
+	return 0;
+}
+
+void heap_remove(struct psched_heap *heap, struct psched_entry *entry) {
+	size_t i = entry->heap_pos - 1;
+
+	/* Nothing to do if the entry isn't queued */
+	if (!entry->heap_pos)
+		return;
+
+	entry->heap_pos = 0;
+
+	/* If it's the last node, just drop it */
+	if (i == -- heap->count)
+		return;
+
+	/* Fill the hole with the last node and restore the heap property */
+	heap->nodes[i] = heap->nodes[heap->count];
+
+	if (i && (timespec_cmp(&heap->nodes[i]->deadline, &heap->nodes[(i - 1) / 2]->deadline) < 0)) {
+		_heap_up(heap, i);
+	} else {
+		_heap_down(heap, i);
+	}
+}
+
+struct psched_entry *heap_top(const struct psched_heap *heap) {
+	return heap->count ? heap->nodes[0] : NULL;
+}
+
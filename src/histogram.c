@@ -0,0 +1,126 @@
+/**
+ * @file histogram.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Latency histogram interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <string.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+/* Statics */
+static unsigned int _histogram_msb(uint64_t value) {
+	return 63 - __builtin_clzll(value);
+}
+
+static unsigned int _histogram_bucket(uint64_t value) {
+	unsigned int msb = 0;
+
+	/* Values below the first power of two split in sub buckets have a bucket of their own */
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return (unsigned int) value;
+
+	if ((msb = _histogram_msb(value)) > HISTOGRAM_MSB_MAX)
+		return HISTOGRAM_BUCKETS - 1;
+
+	return ((msb - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) + ((value >> (msb - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* Largest value accounted on a bucket */
+static uint64_t _histogram_bucket_value(unsigned int bucket) {
+	unsigned int shift = 0;
+
+	if (bucket < HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+
+	shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+
+	return ((uint64_t) (HISTOGRAM_SUB_BUCKETS + (bucket & (HISTOGRAM_SUB_BUCKETS - 1))) << shift) + ((uint64_t) 1 << shift) - 1;
+}
+
+static uint64_t _histogram_percentile(const uint64_t *buckets, uint64_t count, uint64_t permille, uint64_t max) {
+	uint64_t rank = 0, seen = 0, value = 0;
+	unsigned int i = 0;
+
+	if (!count)
+		return 0;
+
+	/* Rank of the value below which the requested fraction of the values lies (rounded up) */
+	rank = (count * permille + 999) / 1000;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i ++) {
+		if ((seen += buckets[i]) >= rank)
+			break;
+	}
+
+	/* The upper bound of the bucket is reported, but never above the largest value recorded */
+	value = _histogram_bucket_value(i < HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS - 1);
+
+	return (value > max) ? max : value;
+}
+
+/* API */
+void histogram_record(struct psched_histogram *hist, uint64_t value) {
+	uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&hist->buckets[_histogram_bucket(value)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+	while ((value > max) && !__atomic_compare_exchange_n(&hist->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void histogram_summary(const struct psched_histogram *hist, struct histogram_summary *summary) {
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	unsigned int i = 0;
+
+	memset(summary, 0, sizeof(struct histogram_summary));
+
+	/* Take a copy of the buckets, so the count and the percentiles agree with each other even if values
+	 * keep being recorded meanwhile.
+	 */
+	for (i = 0; i < HISTOGRAM_BUCKETS; i ++)
+		summary->count += (buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED));
+
+	summary->sum = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+	summary->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+	summary->p50 = _histogram_percentile(buckets, summary->count, 500, summary->max);
+	summary->p99 = _histogram_percentile(buckets, summary->count, 990, summary->max);
+	summary->p999 = _histogram_percentile(buckets, summary->count, 999, summary->max);
+}
+
+/* Adds the values recorded on 'src' to 'dst', which isn't being recorded to */
+void histogram_merge(struct psched_histogram *dst, const struct psched_histogram *src) {
+	uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	unsigned int i = 0;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i ++)
+		dst->buckets[i] += __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+
+	dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+
+	if (max > dst->max)
+		dst->max = max;
+}
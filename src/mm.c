@@ -25,11 +25,48 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef USE_LIBFSMA
  #include <fsma/fsma.h>
 #endif
 
+#include "mm.h"
+
+/* Default and maximum number of objects per pool chunk */
+#define MM_POOL_NMEMB_DEFAULT	64
+#define MM_POOL_NMEMB_MAX	65536
+
+/* Pool objects and chunk headers are aligned to this union */
+union mm_pool_align {
+	void *ptr;
+	long long ll;
+	long double ld;
+};
+
+/* Statics */
+static int _mm_pool_grow(struct mm_pool *pool, size_t nmemb) {
+	size_t hdr = sizeof(union mm_pool_align), i = 0;
+	char *chunk = NULL;
+
+	if (!(chunk = mm_alloc(hdr + (pool->size * nmemb))))
+		return -1;
+
+	/* Link the chunk so it can be released later */
+	*(void **) chunk = pool->chunks;
+	pool->chunks = chunk;
+
+	/* Push all the chunk objects into the free list */
+	for (i = 0; i < nmemb; i ++) {
+		*(void **) (chunk + hdr + (i * pool->size)) = pool->free;
+		pool->free = chunk + hdr + (i * pool->size);
+	}
+
+	pool->avail += nmemb;
+
+	return 0;
+}
+
 void *mm_alloc(size_t size) {
 	return
 #ifdef USE_LIBFSMA
@@ -65,3 +102,69 @@ void *mm_calloc(size_t nmemb, size_t size) {
 #endif
 }
 
+int mm_pool_init(struct mm_pool *pool, size_t size, size_t hint) {
+	size_t align = sizeof(union mm_pool_align);
+
+	memset(pool, 0, sizeof(struct mm_pool));
+
+	/* Objects must be able to hold the free list link */
+	if (size < sizeof(void *))
+		size = sizeof(void *);
+
+	pool->size = ((size + align - 1) / align) * align;
+	pool->nmemb = MM_POOL_NMEMB_DEFAULT;
+
+	/* Preallocate the hinted number of objects. Chunks allocated past them start over from the default size,
+	 * so a large hint doesn't make every later chunk as large.
+	 */
+	if (hint)
+		return _mm_pool_grow(pool, hint);
+
+	return 0;
+}
+
+void mm_pool_destroy(struct mm_pool *pool) {
+	void *chunk = NULL;
+
+	while ((chunk = pool->chunks)) {
+		pool->chunks = *(void **) chunk;
+		mm_free(chunk);
+	}
+
+	pool->free = NULL;
+	pool->avail = 0;
+}
+
+int mm_pool_reserve(struct mm_pool *pool, size_t nmemb) {
+	/* Allocate the missing objects as a single chunk */
+	if (pool->avail >= nmemb)
+		return 0;
+
+	return _mm_pool_grow(pool, nmemb - pool->avail);
+}
+
+void *mm_pool_alloc(struct mm_pool *pool) {
+	void *ptr = NULL;
+
+	if (!pool->free) {
+		if (_mm_pool_grow(pool, pool->nmemb) < 0)
+			return NULL;
+
+		/* Next chunks grow geometrically */
+		if ((pool->nmemb * 2) <= MM_POOL_NMEMB_MAX)
+			pool->nmemb *= 2;
+	}
+
+	ptr = pool->free;
+	pool->free = *(void **) ptr;
+	pool->avail --;
+
+	return ptr;
+}
+
+void mm_pool_free(struct mm_pool *pool, void *ptr) {
+	*(void **) ptr = pool->free;
+	pool->free = ptr;
+	pool->avail ++;
+}
+
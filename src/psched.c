@@ -26,83 +26,218 @@
 
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <limits.h>
 #include <signal.h>
 #include <time.h>
 #include <pthread.h>
-
-#include <pall/cll.h>
-
+#include <sched.h>
+
+#include "epoch.h"
+#include "event.h"
+#include "exec.h"
+#include "fd.h"
+#include "group.h"
+#include "handle.h"
+#include "histogram.h"
 #include "mm.h"
 #include "psched.h"
+#include "queue.h"
+#include "seqcount.h"
 #include "sig.h"
+#include "submit.h"
 #include "thread.h"
 #include "timer_ul.h"
+#include "timespec.h"
+
+/* Entries preallocated on submission mode, if none are specified */
+#define PSCHED_SUBMIT_ENTRIES_DEFAULT	4096
 
 /* Statics */
-static int _cll_compare(const void *d1, const void *d2) {
-	const struct psched_entry *pd1 = (struct psched_entry *) d1, *pd2 = (struct psched_entry *) d2;
+static void _submit_lock(psched_t *handler) {
+	/* On submission mode, the pool and the handle table are shared with the submitting threads */
+	if (handler->submit) pthread_mutex_lock(&handler->submit_mutex);
+}
 
-	if (pd1->id > pd2->id)
-		return 1;
+static void _submit_unlock(psched_t *handler) {
+	if (handler->submit) pthread_mutex_unlock(&handler->submit_mutex);
+}
 
-	if (pd1->id < pd2->id)
-		return -1;
+/* Resolves an entry id. Entries with a submitted disarm are no longer visible. */
+static struct psched_entry *_lookup(psched_t *handler, pschedid_t id) {
+	struct psched_entry *entry = NULL;
 
-	return 0;
+	_submit_lock(handler);
+
+	if ((entry = handle_lookup(&handler->handles, id)) && entry->cancelled)
+		entry = NULL;
+
+	_submit_unlock(handler);
+
+	return entry;
+}
+
+static struct psched_entry *_iterate(psched_t *handler, size_t *pos) {
+	struct psched_entry *entry = NULL;
+
+	_submit_lock(handler);
+
+	entry = handle_iterate(&handler->handles, pos);
+
+	_submit_unlock(handler);
+
+	return entry;
 }
 
-static void _cll_destroy(void *data) {
-	mm_free(data);
+/* Returns the released entries that no lock-free reader may reference anymore to the pool */
+static void _reclaim(psched_t *handler) {
+	struct psched_entry *entry = NULL;
+	uint64_t oldest = epoch_sync(&handler->epoch);
+
+	_submit_lock(handler);
+
+	/* Entries are retired in epoch order */
+	while ((entry = handler->retired) && (entry->retired_epoch < oldest)) {
+		handler->retired = entry->retired_next;
+		handler->nretired --;
+
+		mm_pool_free(&handler->pool, entry);
+	}
+
+	if (!handler->retired)
+		handler->retired_tail = &handler->retired;
+
+	_submit_unlock(handler);
 }
 
-static unsigned int _count_events_in_progress(struct cll_handler *s) {
+static unsigned int _count_events_in_progress(psched_t *handler) {
 	const struct psched_entry *entry = NULL;
 	unsigned int count = 0;
+	size_t pos = 0;
 
-	for (s->rewind(s, 0); (entry = s->iterate(s)); )
+	while ((entry = _iterate(handler, &pos)))
 		count += (entry->in_progress == 1);
 
 	return count;
 }
 
-static psched_t *_init(int sig, int threaded) {
+static psched_t *_init(int sig, int threaded, int pollable, const psched_attr_t *attr) {
+	int errsv = 0;
+	size_t entries = 0;
 	psched_t *handler = NULL;
+	psched_attr_t attr_default;
 	struct sigevent sevp;
 
 	memset(&sevp, 0, sizeof(struct sigevent));
 
+	if (!attr) {
+		psched_attr_init(&attr_default);
+		attr = &attr_default;
+	}
+
+	/* Validate the handler clock */
+	switch (attr->clockid) {
+		case CLOCK_REALTIME: {
+		} break;
+		case CLOCK_MONOTONIC: {
+		} break;
+#ifdef CLOCK_BOOTTIME
+		case CLOCK_BOOTTIME: {
+		} break;
+#endif
+		default: {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	if ((attr->dispatch != PSCHED_DISPATCH_SHARED) && (attr->dispatch != PSCHED_DISPATCH_STEAL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* Routines can only be offloaded to an executor on threaded handlers, which are also the only ones
+	 * creating threads.
+	 */
+	if ((attr->workers || attr->submit || thread_attr_custom(attr)) && !threaded) {
+		errno = EINVAL;
+		return NULL;
+	}
+
 	if (!(handler = mm_alloc(sizeof(psched_t))))
 		return NULL;
 
 	memset(handler, 0, sizeof(psched_t));
 
-	if (threaded) {
-		if (thread_init(handler) < 0) {
-			mm_free(handler);
+	handler->clockid = attr->clockid;
 
-			return NULL;
-		}
+	epoch_init(&handler->epoch);
+	handler->retired_tail = &handler->retired;
+
+	if (threaded) {
+		if (thread_init(handler, attr) < 0)
+			goto _init_failure_thread;
 
 		handler->threaded = 1;
 	}
 
-	if (!(handler->s = pall_cll_init(&_cll_compare, &_cll_destroy, NULL, NULL))) {
-		mm_free(handler);
+	if (attr->submit) {
+		if (pthread_mutex_init(&handler->submit_mutex, NULL))
+			goto _init_failure_pool;
 
-		return NULL;
+		if (pthread_mutex_init(&handler->timer_mutex, NULL)) {
+			pthread_mutex_destroy(&handler->submit_mutex);
+			goto _init_failure_pool;
+		}
+
+		submit_init(&handler->submitq);
+
+		handler->submit = 1;
 	}
 
-	handler->s->set_config(handler->s, CONFIG_SEARCH_AUTO | CONFIG_INSERT_HEAD);
+	/* On submission mode, growing the pool or the handle table holds the submission mutex, so both are
+	 * preallocated to keep that off the arm path.
+	 */
+	entries = attr->entries;
+
+	if (handler->submit && !entries)
+		entries = PSCHED_SUBMIT_ENTRIES_DEFAULT;
+
+	if (mm_pool_init(&handler->pool, sizeof(struct psched_entry), entries) < 0)
+		goto _init_failure_pool;
+
+	if (handle_init(&handler->handles, entries) < 0)
+		goto _init_failure_handles;
+
+	if (group_init(&handler->groups) < 0)
+		goto _init_failure_groups;
+
+	if (queue_init(handler, attr) < 0)
+		goto _init_failure_queue;
+
+	if (attr->workers && (exec_init(&handler->exec, attr->workers, (attr->dispatch == PSCHED_DISPATCH_STEAL) ? EXEC_STEAL : 0, &handler->thread_attr) < 0))
+		goto _init_failure_exec;
+
+	/* Pollable handlers program their deadlines on a descriptor watched by the caller */
+	if (pollable) {
+		if (fd_init(handler) < 0)
+			goto _init_failure_timer;
+
+		handler->pollable = 1;
+
+		return handler;
+	}
 
 	sevp.sigev_value.sival_ptr = handler;
 
 	if (threaded) {
 		sevp.sigev_notify = SIGEV_THREAD;
 		sevp.sigev_notify_function = &thread_handler;
+		sevp.sigev_notify_attributes = &handler->thread_attr;
 	}
 #ifndef PSCHED_NO_SIG
 	 else {
@@ -111,12 +246,14 @@ static psched_t *_init(int sig, int threaded) {
 	}
 #endif
 
-	if (timer_create(CLOCK_REALTIME, &sevp, &handler->timer) < 0) {
-		pall_cll_destroy(handler->s);
-		mm_free(handler);
+#ifdef PSCHED_INTERNAL_TIMER_UL
+	/* Userland timers wait for the expirations on their own threads, shared by the whole process */
+	if (threaded && thread_attr_custom(attr) && (timer_setattr_ul(&handler->thread_attr) < 0))
+		goto _init_failure_timer;
+#endif
 
-		return NULL;
-	}
+	if (timer_create(handler->clockid, &sevp, &handler->timer) < 0)
+		goto _init_failure_timer;
 
 #ifndef PSCHED_NO_SIG
 	if (!threaded) {
@@ -126,127 +263,248 @@ static psched_t *_init(int sig, int threaded) {
 		sigemptyset(&handler->sa.sa_mask);
 
 		if (sigaction(sig, &handler->sa, &handler->sa_old) < 0) {
+			errsv = errno;
 			timer_delete(handler->timer);
-			pall_cll_destroy(handler->s);
-			mm_free(handler);
+			errno = errsv;
 
-			return NULL;
+			goto _init_failure_timer;
 		}
 	}
 #endif
 
 	return handler;
-}
 
-/* Core */
-psched_t *psched_thread_init(void) {
-	return _init(0, 1);
-}
+_init_failure_timer:
+	errsv = errno;
+
+	if (handler->exec.nthreads)
+		exec_destroy(&handler->exec);
+
+	errno = errsv;
+
+_init_failure_exec:
+	queue_destroy(handler);
+
+_init_failure_queue:
+	group_destroy(&handler->groups);
+
+_init_failure_groups:
+	handle_destroy(&handler->handles);
+
+_init_failure_handles:
+	mm_pool_destroy(&handler->pool);
+
+_init_failure_pool:
+	if (handler->submit) {
+		pthread_mutex_destroy(&handler->submit_mutex);
+		pthread_mutex_destroy(&handler->timer_mutex);
+	}
+
+	if (handler->threaded)
+		thread_destroy(handler);
+
+_init_failure_thread:
+	mm_free(handler);
 
-psched_t *psched_sig_init(int sig) {
-#ifdef PSCHED_NO_SIG
-	errno = ENOSYS;
 	return NULL;
-#else
-	return _init(sig, 0);
-#endif
 }
 
-int psched_fatal(psched_t *handler) {
-	return handler->fatal;
+static int _now(psched_t *handler, struct timespec *now) {
+	/* Use the reading of the wakeup being processed by this thread, if any, so a burst of arms from
+	 * an entry routine costs a single clock_gettime(). The reading is refreshed after each routine.
+	 */
+	if (pthread_equal(handler->now_thread, pthread_self()) && handler->now_valid) {
+		memcpy(now, &handler->now, sizeof(struct timespec));
+
+		return 0;
+	}
+
+	return clock_gettime(handler->clockid, now);
 }
 
-int psched_destroy(psched_t *handler) {
-	if (!handler->threaded) {
-		if (sigaction(handler->sig, &handler->sa_old, NULL) < 0)
-			return -1;
+static struct psched_entry *_entry_alloc(
+		psched_t *handler,
+		const struct timespec *trigger,
+		const struct timespec *step,
+		const struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr,
+		const struct timespec *now,
+		int submitted)
+{
+	struct psched_entry *entry = NULL;
+
+	if (attr && ((attr->catchup < PSCHED_CATCHUP_ONCE) || (attr->catchup > PSCHED_CATCHUP_SKIP))) {
+		errno = EINVAL;
+		return NULL;
 	}
 
-	/* Lock event mutex */
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+	_submit_lock(handler);
 
-	/* Set this handler to be destroyed by event handling function when execution queue is empty */
-	handler->destroy = 1;
+	/* Entries are allocated from the handler pool */
+	if (!(entry = mm_pool_alloc(&handler->pool))) {
+		_submit_unlock(handler);
+		return NULL;
+	}
 
-	/* Return error only if no fatal state is currently set. Otherwise (on fatal state) continue
-	 * cleaning the psched data.
-	 */
-	if ((timer_delete(handler->timer) < 0) && !handler->fatal)
-		return -1;
+	memset(entry, 0, sizeof(struct psched_entry));
 
-	/* Wait for any entries that are in progress to complete, before destroying the
-	 * scheduling queue.
-	 */
-	for (;;) {
-		if (!_count_events_in_progress(handler->s))
-			break;
+	memcpy(&entry->trigger, trigger, sizeof(struct timespec));
 
-		if (handler->threaded) pthread_cond_wait(&handler->event_cond, &handler->event_mutex);
+	if (step) 
+		memcpy(&entry->step, step, sizeof(struct timespec));
+
+	if (expire)
+		memcpy(&entry->expire, expire, sizeof(struct timespec));
+
+	/* Relative triggers and expirations are resolved against the handler clock */
+	if (now) {
+		timespec_add(&entry->trigger, now);
+
+		if (entry->expire.tv_sec || entry->expire.tv_nsec)
+			timespec_add(&entry->expire, now);
+	}
+
+	entry->routine = routine;
+	entry->arg = arg;
+	entry->handler = handler;
+	entry->submitted = submitted;
+
+	if (attr) {
+		entry->flags = attr->flags;
+		entry->catchup = attr->catchup;
+
+		memcpy(&entry->slack, &attr->slack, sizeof(struct timespec));
 	}
 
-	/* Destroy the scheduling queue */
-	pall_cll_destroy(handler->s);
+	/* Register the entry on the handle table, which assigns its id */
+	if ((entry->id = handle_alloc(&handler->handles, entry)) == (pschedid_t) -1) {
+		mm_pool_free(&handler->pool, entry);
+		entry = NULL;
+	}
 
-	/* No entry is or will be armed from this point on ... */
-	handler->armed = NULL;
+	_submit_unlock(handler);
 
-	/* Unlock event mutex */
-	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+	return entry;
+}
+
+static int _entry_queue(psched_t *handler, struct psched_entry *entry, uintptr_t group) {
+	if (group && (group_add(&handler->groups, entry, group) < 0)) {
+		psched_entry_release(handler, entry);
+
+		return -1;
+	}
+
+	if (queue_insert(handler, entry) < 0) {
+		psched_entry_release(handler, entry);
+
+		return -1;
+	}
 
 	return 0;
 }
 
-void psched_handler_destroy(psched_t *handler) {
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+static struct psched_entry *_entry_create(
+		psched_t *handler,
+		const struct timespec *trigger,
+		const struct timespec *step,
+		const struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr,
+		const struct timespec *now)
+{
+	struct psched_entry *entry = NULL;
 
-	/* Wait for any armed entry to be disarmed */
-	for (;;) {
-		if (!handler->armed)
-			break;
+	if (!(entry = _entry_alloc(handler, trigger, step, expire, routine, arg, attr, now, 0)))
+		return NULL;
 
-		if (handler->threaded) pthread_cond_wait(&handler->event_cond, &handler->event_mutex);
-	}
+	if (_entry_queue(handler, entry, attr ? attr->group : 0) < 0)
+		return NULL;
 
-	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+	return entry;
+}
 
-	/* Destroy the threading interface */
-	thread_destroy(handler);
+/* Programs the timer for a submitted deadline, if it's earlier than the one already armed. Only the timer
+ * mutex is taken, and only in that case.
+ */
+static void _submit_kick(psched_t *handler, const struct timespec *deadline) {
+	struct itimerspec its;
+	uint64_t ns = timespec_to_ns(deadline), armed = 0;
 
-	/* Free handler memory */
-	mm_free(handler);
+	armed = __atomic_load_n(&handler->armed_ns, __ATOMIC_SEQ_CST);
+
+	if (armed && (armed <= ns))
+		return;
+
+	memset(&its, 0, sizeof(struct itimerspec));
+
+	pthread_mutex_lock(&handler->timer_mutex);
+
+	armed = __atomic_load_n(&handler->armed_ns, __ATOMIC_SEQ_CST);
+
+	if (!handler->destroy && (!armed || (ns < armed))) {
+		memcpy(&its.it_value, deadline, sizeof(struct timespec));
+
+		if (!timer_settime(handler->timer, TIMER_ABSTIME, &its, NULL))
+			__atomic_store_n(&handler->armed_ns, ns, __ATOMIC_SEQ_CST);
+	}
+
+	pthread_mutex_unlock(&handler->timer_mutex);
 }
 
-pschedid_t psched_timestamp_arm(
+static pschedid_t _submit_arm(
 		psched_t *handler,
-		time_t trigger,
-		time_t step,
-		time_t expire,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
 		void (*routine) (void *),
-		void *arg)
+		void *arg,
+		const psched_arm_attr_t *attr,
+		int relative)
 {
-	struct timespec ts_trigger, ts_step, ts_expire;
+	struct psched_entry *entry = NULL;
+	struct timespec now, deadline;
+	pschedid_t id = 0;
 
-	ts_trigger.tv_sec = trigger;
-	ts_trigger.tv_nsec = 0;
+	/* The clock reading of the wakeup being processed belongs to the scheduler, so it isn't used here */
+	if (relative && (clock_gettime(handler->clockid, &now) < 0))
+		return (pschedid_t) -1;
 
-	ts_step.tv_sec = step;
-	ts_step.tv_nsec = 0;
+	if (!(entry = _entry_alloc(handler, trigger, step, expire, routine, arg, attr, relative ? &now : NULL, 1)))
+		return (pschedid_t) -1;
 
-	ts_expire.tv_sec = expire;
-	ts_expire.tv_nsec = 0;
+	/* The entry belongs to the scheduler as soon as it's pushed */
+	id = entry->id;
 
-	return psched_timespec_arm(handler, &ts_trigger, &ts_step, &ts_expire, routine, arg);
+	memcpy(&deadline, &entry->trigger, sizeof(struct timespec));
+	timespec_add(&deadline, &entry->slack);
+
+	entry->submit.type = SUBMIT_ARM;
+	entry->submit.entry = entry;
+	entry->submit.group = attr ? attr->group : 0;
+
+	submit_push(&handler->submitq, &entry->submit);
+
+	_submit_kick(handler, &deadline);
+
+	return id;
 }
 
-pschedid_t psched_timespec_arm(
+static pschedid_t _arm(
 		psched_t *handler,
 		struct timespec *trigger,
 		struct timespec *step,
 		struct timespec *expire,
 		void (*routine) (void *),
-		void *arg)
+		void *arg,
+		const psched_arm_attr_t *attr,
+		int relative)
 {
 	struct psched_entry *entry = NULL;
+	struct timespec now;
+	int errsv = 0;
 
 	/* Check if a fatal error occurred */
 	if (handler->fatal) {
@@ -264,31 +522,37 @@ pschedid_t psched_timespec_arm(
 		return (pschedid_t) -1;
 	}
 
-	if (!(entry = mm_alloc(sizeof(struct psched_entry))))
-		return (pschedid_t) -1;
+	if (handler->submit)
+		return _submit_arm(handler, trigger, step, expire, routine, arg, attr, relative);
 
-	memset(entry, 0, sizeof(struct psched_entry));
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
 
-	memcpy(&entry->trigger, trigger, sizeof(struct timespec));
+	if (relative && (_now(handler, &now) < 0)) {
+		errsv = errno;
 
-	if (step) 
-		memcpy(&entry->step, step, sizeof(struct timespec));
+		/* Unlock event mutex */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-	if (expire)
-		memcpy(&entry->expire, expire, sizeof(struct timespec));
+		errno = errsv;
 
-	entry->routine = routine;
-	entry->arg = arg;
+		return (pschedid_t) -1;
+	}
 
-	entry->id = (pschedid_t) (uintptr_t) entry;
+	if (!(entry = _entry_create(handler, trigger, step, expire, routine, arg, attr, relative ? &now : NULL))) {
+		errsv = errno;
 
-	/* Lock event mutex */
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+		/* Unlock event mutex */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-	handler->s->insert(handler->s, entry);
+		errno = errsv;
+
+		return (pschedid_t) -1;
+	}
 
 	if (psched_update_timers(handler) < 0) {
-		handler->s->del(handler->s, entry);
+		queue_remove(handler, entry);
+		psched_entry_release(handler, entry);
 
 		if (psched_update_timers(handler) < 0) {
 			handler->fatal = 1;
@@ -303,100 +567,855 @@ pschedid_t psched_timespec_arm(
 		return -1;
 	}
 
+	handler->counters.arms ++;
+
 	/* Unlock event mutex */
 	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
 	return entry->id;
 }
 
-int psched_disarm(psched_t *handler, pschedid_t id) {
-	int ret = 0;
-	struct itimerspec its;
-	struct psched_entry *entry = NULL;
+static void _disarm(psched_t *handler, struct psched_entry *entry) {
+	/* If the entry wasn't queued yet, let the submission queue drop it */
+	if (entry->submitted) {
+		_submit_lock(handler);
+		__atomic_store_n(&entry->cancelled, 1, __ATOMIC_RELAXED);
+		_submit_unlock(handler);
 
-	/* Check if a fatal error occurred */
-	if (handler->fatal) {
-		errno = ECANCELED; /* A clean restart of the library is required */
-		return -1;
+		return;
 	}
 
-	memset(&its, 0, sizeof(struct itimerspec));
-
-	/* Lock event mutex */
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+	/* If the entry is being processed, let the event processing remove it when it's done */
+	if (entry->in_progress) {
+		__atomic_store_n(&entry->to_remove, 1, __ATOMIC_RELAXED);
+		entry->rearmed = 0;
 
-	/* Search for scheduling entry */
-	if (!(entry = handler->s->search(handler->s, psched_val(id)))) {
-		/* Unlock event mutex */
-		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+		handler->counters.disarms ++;
 
-		errno = EINVAL;
-		return -1;
+		return;
 	}
 
-	/* Check if the found entry is currently armed */
-	if (entry != handler->armed) {
-		handler->s->del(handler->s, entry);
-
-		/* Unlock event mutex */
-		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
-
-		return 0;
-	}
+	queue_remove(handler, entry);
 
-	/* NOTE: If the entry to be delete is armed, we need to disarm the timer and reset the handler->armed pointer
-	 * before we can delete it from the handlers list.
-	 */
+	psched_entry_release(handler, entry);
 
-	/* Disarm timer */
-	if (timer_settime(handler->timer, TIMER_ABSTIME, &its, NULL) < 0) {
-		/* Unlock event mutex */
-		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+	handler->counters.disarms ++;
+}
 
-		return -1;
-	}
+static int _disarm_finish(psched_t *handler, int disarmed) {
+	/* Re-arm the timer once for all the disarmed entries (no-op if the next deadline didn't change) */
+	if (psched_update_timers(handler) < 0)
+		disarmed = -1;
 
-	handler->armed = NULL;
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
 
-	handler->s->del(handler->s, entry);
+	return disarmed;
+}
 
-	ret = psched_update_timers(handler);
+/* Appends to the output of psched_stats_prometheus(), keeping track of the full length */
+static void _stats_print(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+	va_list ap;
+	int ret = 0;
 
-	/* Unlock event mutex */
-	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+	va_start(ap, fmt);
+	ret = vsnprintf(buf + (*len < size ? *len : size), *len < size ? size - *len : 0, fmt, ap);
+	va_end(ap);
 
-	return ret;
+	if (ret > 0)
+		*len += ret;
 }
 
-/**
- * NOTE: This function does not grant that after it returns the entry still exists, unless it is called inside the
- *       notification routine, invoked by timer expiration.
- *
+/* Core */
+int psched_attr_init(psched_attr_t *attr) {
+	memset(attr, 0, sizeof(psched_attr_t));
+
+	attr->backend = PSCHED_BACKEND_HEAP;
+	attr->clockid = CLOCK_REALTIME;
+	attr->policy = SCHED_OTHER;
+
+	return 0;
+}
+
+int psched_arm_attr_init(psched_arm_attr_t *attr) {
+	memset(attr, 0, sizeof(psched_arm_attr_t));
+
+	return 0;
+}
+
+psched_t *psched_thread_init(void) {
+	return _init(0, 1, 0, NULL);
+}
+
+psched_t *psched_thread_init_ex(const psched_attr_t *attr) {
+	return _init(0, 1, 0, attr);
+}
+
+psched_t *psched_sig_init(int sig) {
+	return psched_sig_init_ex(sig, NULL);
+}
+
+psched_t *psched_sig_init_ex(int sig, const psched_attr_t *attr) {
+#ifdef PSCHED_NO_SIG
+	errno = ENOSYS;
+	return NULL;
+#else
+	return _init(sig, 0, 0, attr);
+#endif
+}
+
+psched_t *psched_fd_init(void) {
+	return _init(0, 0, 1, NULL);
+}
+
+psched_t *psched_fd_init_ex(const psched_attr_t *attr) {
+	return _init(0, 0, 1, attr);
+}
+
+/* Descriptor of a pollable handler, readable when some entry is due */
+int psched_fd(psched_t *handler) {
+	if (!handler->pollable) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return handler->fd;
+}
+
+/* Runs up to 'max' due entries (all of them if 0) on the calling thread. Meant for pollable handlers, once their
+ * descriptor is readable. Entries left due are reported by the descriptor right away.
+ */
+int psched_dispatch(psched_t *handler, unsigned int max) {
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	if (!handler->pollable) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd_clear(handler);
+
+	return event_process(handler, max);
+}
+
+/* Retrieves the earliest deadline of the handler, on its clock. Returns 0 if no entry is armed. */
+int psched_next_deadline(psched_t *handler, struct timespec *deadline) {
+	int found = 0;
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	found = queue_next(handler, deadline);
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return found;
+}
+
+int psched_fatal(psched_t *handler) {
+	return handler->fatal;
+}
+
+int psched_counters_get(psched_t *handler, psched_counters_t *counters) {
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	memcpy(counters, &handler->counters, sizeof(psched_counters_t));
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return 0;
+}
+
+int psched_stats_enable(psched_t *handler, int enable) {
+	__atomic_store_n(&handler->stats, !!enable, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+/* Summarizes latency histograms into 'stats' (the counters are left untouched) */
+void psched_stats_summarize(psched_stats_t *stats, const struct psched_histogram *lateness, const struct psched_histogram *runtime) {
+	struct histogram_summary summary;
+
+	histogram_summary(lateness, &summary);
+
+	stats->lateness.count = summary.count;
+	stats->lateness.sum = summary.sum;
+	stats->lateness.p50 = summary.p50;
+	stats->lateness.p99 = summary.p99;
+	stats->lateness.p999 = summary.p999;
+	stats->lateness.max = summary.max;
+
+	histogram_summary(runtime, &summary);
+
+	stats->runtime.count = summary.count;
+	stats->runtime.sum = summary.sum;
+	stats->runtime.p50 = summary.p50;
+	stats->runtime.p99 = summary.p99;
+	stats->runtime.p999 = summary.p999;
+	stats->runtime.max = summary.max;
+}
+
+/* The histograms are read without the event mutex, so taking a snapshot doesn't delay the wakeups */
+int psched_stats_snapshot(psched_t *handler, psched_stats_t *stats) {
+	psched_stats_summarize(stats, &handler->lateness, &handler->runtime);
+
+	return 0;
+}
+
+int psched_stats_get(psched_t *handler, psched_stats_t *stats) {
+	psched_counters_get(handler, &stats->counters);
+
+	return psched_stats_snapshot(handler, stats);
+}
+
+/* Renders the statistics in the Prometheus text exposition format, labeled with 'name' (if not NULL). Like
+ * snprintf(), the output is truncated to 'size' bytes and the length of the full output is returned.
+ */
+int psched_stats_prometheus(const psched_stats_t *stats, const char *name, char *buf, size_t size) {
+	static const char *quantiles[] = { "0.5", "0.99", "0.999" };
+	const psched_latency_t *latency = NULL;
+	const char *metric = NULL;
+	uint64_t values[3];
+	size_t len = 0;
+	char label[256] = "";
+	int i = 0, j = 0;
+	struct {
+		const char *metric;
+		const char *type;
+		const char *help;
+		uint64_t value;
+	} counters[] = {
+		{ "psched_wakeups_total", "counter", "Timer expirations processed.", stats->counters.wakeups },
+		{ "psched_wakeups_saved_total", "counter", "Wakeups avoided by entries with slack.", stats->counters.wakeups_saved },
+		{ "psched_arms_total", "counter", "Entries armed.", stats->counters.arms },
+		{ "psched_disarms_total", "counter", "Entries disarmed.", stats->counters.disarms },
+		{ "psched_fires_total", "counter", "Routines dispatched.", stats->counters.fires },
+		{ "psched_reschedules_total", "counter", "Recurrent entries queued again after firing.", stats->counters.reschedules },
+		{ "psched_expired_total", "counter", "Entries removed after reaching their expiration.", stats->counters.expired },
+		{ "psched_timer_updates_total", "counter", "Calls to timer_settime().", stats->counters.timer_updates },
+		{ "psched_missed_periods_total", "counter", "Periods of recurrent entries skipped.", stats->counters.missed },
+		{ "psched_lock_wait_nanoseconds_total", "counter", "Time spent waiting for the event mutex.", stats->counters.lock_wait },
+		{ "psched_queued_entries", "gauge", "Entries currently queued.", stats->counters.queued },
+	};
+
+	if (name && (snprintf(label, sizeof(label), "handler=\"%s\"", name) >= (int) sizeof(label))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < (int) (sizeof(counters) / sizeof(counters[0])); i ++) {
+		_stats_print(buf, size, &len, "# HELP %s %s\n# TYPE %s %s\n", counters[i].metric, counters[i].help, counters[i].metric, counters[i].type);
+		_stats_print(buf, size, &len, "%s%s%s%s %llu\n", counters[i].metric, *label ? "{" : "", label, *label ? "}" : "", (unsigned long long) counters[i].value);
+	}
+
+	for (i = 0; i < 2; i ++) {
+		latency = i ? &stats->runtime : &stats->lateness;
+		metric = i ? "psched_runtime_seconds" : "psched_lateness_seconds";
+
+		values[0] = latency->p50;
+		values[1] = latency->p99;
+		values[2] = latency->p999;
+
+		_stats_print(buf, size, &len, "# HELP %s %s\n# TYPE %s summary\n", metric, i ? "Time taken by the routines." : "Time from the entry trigger to the start of its routine.", metric);
+
+		for (j = 0; j < 3; j ++)
+			_stats_print(buf, size, &len, "%s{%s%squantile=\"%s\"} %.9f\n", metric, label, *label ? "," : "", quantiles[j], values[j] / 1e9);
+
+		_stats_print(buf, size, &len, "%s_sum%s%s%s %.9f\n", metric, *label ? "{" : "", label, *label ? "}" : "", latency->sum / 1e9);
+		_stats_print(buf, size, &len, "%s_count%s%s%s %llu\n", metric, *label ? "{" : "", label, *label ? "}" : "", (unsigned long long) latency->count);
+	}
+
+	return (int) len;
+}
+
+int psched_destroy(psched_t *handler) {
+	if (!handler->threaded && !handler->pollable) {
+		if (sigaction(handler->sig, &handler->sa_old, NULL) < 0)
+			return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Submitters must not re-program the timer once it's deleted */
+	if (handler->submit) pthread_mutex_lock(&handler->timer_mutex);
+
+	/* Set this handler to be destroyed by event handling function when execution queue is empty */
+	handler->destroy = 1;
+
+	if (handler->submit) pthread_mutex_unlock(&handler->timer_mutex);
+
+	/* Deleting a userland timer waits for its notification in progress, which may be waiting for the event
+	 * mutex, so the timer is deleted without holding it. Any notification from now on returns right away.
+	 */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	/* Return error only if no fatal state is currently set. Otherwise (on fatal state) continue
+	 * cleaning the psched data.
+	 */
+	if (handler->pollable) {
+		fd_destroy(handler);
+	} else if ((timer_delete(handler->timer) < 0) && !handler->fatal) {
+		return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Pending requests are applied, so their entries are released along with the scheduling queue */
+	if (handler->submit) psched_submit_drain(handler);
+
+	/* Wait for any entries that are in progress to complete, before destroying the
+	 * scheduling queue.
+	 */
+	for (;;) {
+		if (!_count_events_in_progress(handler))
+			break;
+
+		if (handler->threaded) pthread_cond_wait(&handler->event_cond, &handler->event_mutex);
+	}
+
+	/* No entry is or will be armed from this point on ... */
+	handler->armed = 0;
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	/* All routines have completed, so the executor threads are idle and can be joined */
+	if (handler->exec.nthreads)
+		exec_destroy(&handler->exec);
+
+	/* Destroy the scheduling queue and release all the entries at once */
+	queue_destroy(handler);
+	group_destroy(&handler->groups);
+	handle_destroy(&handler->handles);
+	mm_pool_destroy(&handler->pool);
+
+	/* Retired entries were carved from the pool */
+	handler->retired = NULL;
+	handler->retired_tail = &handler->retired;
+	handler->nretired = 0;
+
+	if (handler->submit) {
+		pthread_mutex_destroy(&handler->submit_mutex);
+		pthread_mutex_destroy(&handler->timer_mutex);
+	}
+
+	return 0;
+}
+
+void psched_handler_destroy(psched_t *handler) {
+	if (handler->threaded) thread_lock(handler);
+
+	/* Wait for the timer to be disarmed */
+	for (;;) {
+		if (!handler->armed)
+			break;
+
+		if (handler->threaded) pthread_cond_wait(&handler->event_cond, &handler->event_mutex);
+	}
+
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	/* Destroy the threading interface */
+	thread_destroy(handler);
+
+	/* Free handler memory */
+	mm_free(handler);
+}
+
+pschedid_t psched_timestamp_arm(
+		psched_t *handler,
+		time_t trigger,
+		time_t step,
+		time_t expire,
+		void (*routine) (void *),
+		void *arg)
+{
+	struct timespec ts_trigger, ts_step, ts_expire;
+
+	ts_trigger.tv_sec = trigger;
+	ts_trigger.tv_nsec = 0;
+
+	ts_step.tv_sec = step;
+	ts_step.tv_nsec = 0;
+
+	ts_expire.tv_sec = expire;
+	ts_expire.tv_nsec = 0;
+
+	return psched_timespec_arm(handler, &ts_trigger, &ts_step, &ts_expire, routine, arg);
+}
+
+pschedid_t psched_timespec_arm(
+		psched_t *handler,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg)
+{
+	return psched_timespec_arm_ex(handler, trigger, step, expire, routine, arg, NULL);
+}
+
+pschedid_t psched_timespec_arm_ex(
+		psched_t *handler,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr)
+{
+	return _arm(handler, trigger, step, expire, routine, arg, attr, 0);
+}
+
+pschedid_t psched_timespec_arm_in(
+		psched_t *handler,
+		struct timespec *delay,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr)
+{
+	return _arm(handler, delay, step, expire, routine, arg, attr, 1);
+}
+
+int psched_timespec_arm_batch(
+		psched_t *handler,
+		const psched_arm_req_t *reqs,
+		size_t count,
+		pschedid_t *ids,
+		const psched_arm_attr_t *attr)
+{
+	struct psched_entry *entry = NULL;
+	size_t i = 0;
+	int errsv = 0;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	if (!reqs || !ids) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < count; i ++) {
+		if (!reqs[i].routine) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Make room for the whole batch at once, so the entries are carved from a single block */
+	_submit_lock(handler);
+
+	if (mm_pool_reserve(&handler->pool, count) < 0) {
+		errsv = errno;
+		_submit_unlock(handler);
+		goto _batch_failure;
+	}
+
+	_submit_unlock(handler);
+
+	for (i = 0; i < count; i ++) {
+		if (!(entry = _entry_create(handler, &reqs[i].trigger, &reqs[i].step, &reqs[i].expire, reqs[i].routine, reqs[i].arg, attr, NULL))) {
+			errsv = errno;
+			goto _batch_failure;
+		}
+
+		ids[i] = entry->id;
+	}
+
+	/* A single timer update for the whole batch */
+	if (psched_update_timers(handler) < 0) {
+		errsv = ECANCELED;
+		goto _batch_failure;
+	}
+
+	handler->counters.arms += count;
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return 0;
+
+_batch_failure:
+	/* The batch is either armed as a whole or not at all */
+	while (i --) {
+		entry = _lookup(handler, ids[i]);
+
+		queue_remove(handler, entry);
+		psched_entry_release(handler, entry);
+
+		ids[i] = (pschedid_t) -1;
+	}
+
+	if (psched_update_timers(handler) < 0) {
+		handler->fatal = 1;
+		abort();
+	}
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	errno = errsv;
+
+	return -1;
+}
+
+int psched_disarm(psched_t *handler, pschedid_t id) {
+	int ret = 0;
+	struct psched_entry *entry = NULL;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	/* On submission mode, the entry is hidden right away and removed by the scheduler later on. Once
+	 * cancelled, an entry can't be disarmed again, so its embedded disarm request is queued at most once.
+	 */
+	if (handler->submit) {
+		pthread_mutex_lock(&handler->submit_mutex);
+
+		if (!(entry = handle_lookup(&handler->handles, id)) || entry->cancelled) {
+			pthread_mutex_unlock(&handler->submit_mutex);
+
+			errno = EINVAL;
+			return -1;
+		}
+
+		__atomic_store_n(&entry->cancelled, 1, __ATOMIC_RELAXED);
+
+		/* The entry memory is kept until the request is drained (see psched_entry_release()) */
+		entry->cancel_queued = 1;
+
+		pthread_mutex_unlock(&handler->submit_mutex);
+
+		entry->cancel.type = SUBMIT_DISARM;
+		entry->cancel.entry = entry;
+
+		submit_push(&handler->submitq, &entry->cancel);
+
+		return 0;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Search for scheduling entry */
+	if (!(entry = _lookup(handler, id)) || entry->to_remove) {
+		/* Unlock event mutex */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+		errno = EINVAL;
+		return -1;
+	}
+
+	_disarm(handler, entry);
+
+	/* Re-arm the timer if the next deadline changed (no-op otherwise) */
+	ret = psched_update_timers(handler);
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return ret;
+}
+
+int psched_disarm_many(psched_t *handler, const pschedid_t *ids, size_t count) {
+	struct psched_entry *entry = NULL;
+	size_t i = 0;
+	int disarmed = 0;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Apply the submitted requests first, so they're not overtaken */
+	if (handler->submit) psched_submit_drain(handler);
+
+	/* Unknown or already disarmed ids are skipped */
+	for (i = 0; i < count; i ++) {
+		if (!(entry = _lookup(handler, ids[i])) || entry->to_remove)
+			continue;
+
+		_disarm(handler, entry);
+
+		disarmed ++;
+	}
+
+	return _disarm_finish(handler, disarmed);
+}
+
+int psched_disarm_group(psched_t *handler, uintptr_t group) {
+	struct psched_group *g = NULL;
+	struct psched_entry *entry = NULL, *next = NULL;
+	int disarmed = 0;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Apply the submitted requests first, so they're not overtaken */
+	if (handler->submit) psched_submit_drain(handler);
+
+	/* Walk the group members only. The group is released along with its last member. */
+	if (group && (g = group_lookup(&handler->groups, group))) {
+		for (entry = g->entries; entry; entry = next) {
+			next = entry->group_next;
+
+			if (entry->to_remove)
+				continue;
+
+			_disarm(handler, entry);
+
+			disarmed ++;
+		}
+	}
+
+	return _disarm_finish(handler, disarmed);
+}
+
+int psched_disarm_all(psched_t *handler) {
+	struct psched_entry *entry = NULL;
+	size_t pos = 0;
+	int disarmed = 0;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Apply the submitted requests first, so they're not overtaken */
+	if (handler->submit) psched_submit_drain(handler);
+
+	while ((entry = _iterate(handler, &pos))) {
+		if (entry->to_remove || entry->cancelled)
+			continue;
+
+		_disarm(handler, entry);
+
+		disarmed ++;
+	}
+
+	return _disarm_finish(handler, disarmed);
+}
+
+/* Resolves the entry to be rescheduled, with the event mutex held on success */
+static struct psched_entry *_reschedule_lookup(psched_t *handler, pschedid_t id) {
+	struct psched_entry *entry = NULL;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return NULL;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
+
+	/* Apply the submitted requests first, so they're not overtaken */
+	if (handler->submit) psched_submit_drain(handler);
+
+	if (!(entry = _lookup(handler, id)) || entry->to_remove) {
+		/* Unlock event mutex */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return entry;
+}
+
+static int _reschedule_finish(psched_t *handler) {
+	int ret = 0;
+
+	/* Re-arm the timer if the next deadline changed (no-op otherwise) */
+	ret = psched_update_timers(handler);
+
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return ret;
+}
+
+/* Moves a queued entry to a new trigger, keeping its id and memory. Called inside a write section of the entry
+ * sequence counter.
  */
-int psched_search(
+static void _reschedule(psched_t *handler, struct psched_entry *entry, const struct timespec *trigger) {
+	queue_remove(handler, entry);
+
+	memcpy(&entry->trigger, trigger, sizeof(struct timespec));
+
+	entry->touched = 0;
+	entry->overrun = 0;
+
+	if (queue_insert(handler, entry) < 0) {
+		handler->fatal = 1;
+		abort();
+	}
+}
+
+/* Reschedules an armed entry in place. The entry keeps its id, routine, argument and arm attributes. Entries
+ * in progress are rescheduled once their routine returns, even if they weren't recurrent.
+ */
+int psched_rearm(
 		psched_t *handler,
 		pschedid_t id,
 		struct timespec *trigger,
 		struct timespec *step,
-		struct timespec *expire) {
+		struct timespec *expire)
+{
 	struct psched_entry *entry = NULL;
-	int ret = -1;
 
-	/* Check if a fatal error occurred */
-	if (handler->fatal) {
-		errno = ECANCELED; /* A clean restart of the library is required */
+	if (!trigger) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!(entry = _reschedule_lookup(handler, id)))
+		return -1;
+
+	/* The trigger of entries in progress is owned by the event processing until they're done */
+	if (entry->in_progress) {
+		memcpy(&entry->rearm_trigger, trigger, sizeof(struct timespec));
+		memset(&entry->rearm_step, 0, sizeof(struct timespec));
+		memset(&entry->rearm_expire, 0, sizeof(struct timespec));
+
+		if (step)
+			memcpy(&entry->rearm_step, step, sizeof(struct timespec));
+
+		if (expire)
+			memcpy(&entry->rearm_expire, expire, sizeof(struct timespec));
+
+		entry->rearmed = 1;
+	} else {
+		seqcount_write_begin(&entry->seq);
+
+		memset(&entry->step, 0, sizeof(struct timespec));
+		memset(&entry->expire, 0, sizeof(struct timespec));
+
+		if (step)
+			memcpy(&entry->step, step, sizeof(struct timespec));
+
+		if (expire)
+			memcpy(&entry->expire, expire, sizeof(struct timespec));
+
+		_reschedule(handler, entry, trigger);
+
+		seqcount_write_end(&entry->seq);
+	}
+
+	return _reschedule_finish(handler);
+}
+
+/* Pushes the trigger of an armed entry to 'delay' from now. Deadlines that are only extended, as for idle
+ * timeouts refreshed on every activity, are recorded without touching the scheduling queue: the entry is moved
+ * once it reaches the head of the queue, so a refresh costs O(1) regardless of how often it happens.
+ */
+int psched_touch(psched_t *handler, pschedid_t id, struct timespec *delay) {
+	struct psched_entry *entry = NULL;
+	struct timespec trigger;
+
+	if (!delay) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!(entry = _reschedule_lookup(handler, id)))
+		return -1;
+
+	/* Touches come from I/O threads while other routines may be running, so the clock is always read */
+	if (clock_gettime(handler->clockid, &trigger) < 0) {
+		/* Unlock event mutex */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
 		return -1;
 	}
 
+	timespec_add(&trigger, delay);
+
+	if (entry->in_progress) {
+		/* Keep the period and expiration of an earlier psched_rearm(), if any */
+		if (!entry->rearmed) {
+			memcpy(&entry->rearm_step, &entry->step, sizeof(struct timespec));
+			memcpy(&entry->rearm_expire, &entry->expire, sizeof(struct timespec));
+		}
+
+		memcpy(&entry->rearm_trigger, &trigger, sizeof(struct timespec));
+
+		entry->rearmed = 1;
+	} else if (timespec_cmp(&trigger, &entry->trigger) >= 0) {
+		/* The entry still fires at its old deadline, where it's moved to the recorded one instead */
+		seqcount_write_begin(&entry->seq);
+		memcpy(&entry->touch, &trigger, sizeof(struct timespec));
+		entry->touched = 1;
+		seqcount_write_end(&entry->seq);
+
+		/* Nothing changed on the scheduling queue, so there's no timer to update */
+		if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+		return 0;
+	} else {
+		/* Bringing the deadline closer must reorder the queue right away */
+		seqcount_write_begin(&entry->seq);
+		_reschedule(handler, entry, &trigger);
+		seqcount_write_end(&entry->seq);
+	}
+
+	return _reschedule_finish(handler);
+}
+
+static int _search_locked(
+		psched_t *handler,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire)
+{
+	struct psched_entry *entry = NULL;
+	int ret = -1;
+
 	/* Lock event mutex */
-	if (handler->threaded) pthread_mutex_lock(&handler->event_mutex);
+	if (handler->threaded) thread_lock(handler);
 
 	/* Search for scheduling entry */
-	entry = handler->s->search(handler->s, psched_val(id));
+	entry = _lookup(handler, id);
 
 	/* If the entry was found, update trigger, step and expire arguments */
 	if (entry && !entry->to_remove) {
-		memcpy(trigger, &entry->trigger, sizeof(struct timespec));
+		memcpy(trigger, entry->touched ? &entry->touch : &entry->trigger, sizeof(struct timespec));
 		memcpy(step, &entry->step, sizeof(struct timespec));
 		memcpy(expire, &entry->expire, sizeof(struct timespec));
 
@@ -409,51 +1428,239 @@ int psched_search(
 	return ret;
 }
 
-int psched_update_timers(psched_t *handler) {
-	struct itimerspec its;
+/**
+ * NOTE: The trigger, step and expiration retrieved are a consistent snapshot of the entry, taken at some point
+ *       during the call. The entry may be rescheduled, fire or be disarmed right after this function returns.
+ *
+ *       The entry is read without taking the event mutex, so polling the schedule doesn't contend with the event
+ *       processing. Entry memory is only reused once no reader may be copying it (see epoch.h).
+ *
+ */
+int psched_search(
+		psched_t *handler,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire) {
 	struct psched_entry *entry = NULL;
+	struct timespec snapshot[3];
+	pschedid_t found = 0;
+	unsigned int seq = 0;
+	int slot = -1, ret = -1;
 
-	memset(&its, 0, sizeof(struct itimerspec));
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
 
-	/* Check if the handler is being destroyed */
-	if (handler->destroy)
-		return 0;
+	/* Too many concurrent readers. Take the event mutex instead. */
+	if ((slot = epoch_enter(&handler->epoch)) < 0)
+		return _search_locked(handler, id, trigger, step, expire);
 
-	/* Check if there's an armed entry */
-	if (handler->armed) {
-		/* Disarm timer */
-		if (timer_settime(handler->timer, TIMER_ABSTIME, &its, NULL) < 0)
-			return -1;
+	if ((entry = handle_lookup(&handler->handles, id))) {
+		/* Copy the entry again if it was updated meanwhile */
+		do {
+			seq = seqcount_read_begin(&entry->seq);
+
+			found = entry->id;
+
+			memcpy(&snapshot[0], entry->touched ? &entry->touch : &entry->trigger, sizeof(struct timespec));
+			memcpy(&snapshot[1], &entry->step, sizeof(struct timespec));
+			memcpy(&snapshot[2], &entry->expire, sizeof(struct timespec));
+		} while (seqcount_read_retry(&entry->seq, seq));
+
+		/* The slot may have been reused by another entry since it was looked up */
+		if (handle_match(found, id) && !__atomic_load_n(&entry->to_remove, __ATOMIC_RELAXED) && !__atomic_load_n(&entry->cancelled, __ATOMIC_RELAXED)) {
+			memcpy(trigger, &snapshot[0], sizeof(struct timespec));
+			memcpy(step, &snapshot[1], sizeof(struct timespec));
+			memcpy(expire, &snapshot[2], sizeof(struct timespec));
+
+			ret = 0;
+		}
+	}
+
+	epoch_leave(&handler->epoch, slot);
+
+	return ret;
+}
+
+/* Retrieves the number of periods the entry missed when it last fired. Meant to be called from the entry
+ * routine, like timer_getoverrun() from a timer notification.
+ */
+int psched_overrun(psched_t *handler, pschedid_t id) {
+	struct psched_entry *entry = NULL;
+	int ret = -1;
+
+	/* Check if a fatal error occurred */
+	if (handler->fatal) {
+		errno = ECANCELED; /* A clean restart of the library is required */
+		return -1;
+	}
+
+	/* Lock event mutex */
+	if (handler->threaded) thread_lock(handler);
 
-		handler->armed = NULL;
+	if ((entry = _lookup(handler, id))) {
+		ret = (entry->overrun > INT_MAX) ? INT_MAX : (int) entry->overrun;
+	} else {
+		errno = EINVAL;
 	}
 
-	for (handler->s->rewind(handler->s, 0); (entry = handler->s->iterate(handler->s)); ) {
-		if (entry->in_progress)
+	/* Unlock event mutex */
+	if (handler->threaded) pthread_mutex_unlock(&handler->event_mutex);
+
+	return ret;
+}
+
+static void _entry_retire(psched_t *handler, struct psched_entry *entry) {
+	/* Lock-free readers may still be copying the entry, so it's only reused once they're gone */
+	entry->retired_epoch = epoch_retire(&handler->epoch);
+	entry->retired_next = NULL;
+
+	*handler->retired_tail = entry;
+	handler->retired_tail = &entry->retired_next;
+
+	if (++ handler->nretired >= PSCHED_EPOCH_BATCH)
+		_reclaim(handler);
+}
+
+void psched_entry_release(psched_t *handler, struct psched_entry *entry) {
+	int deferred = 0;
+
+	group_del(&handler->groups, entry);
+
+	_submit_lock(handler);
+
+	handle_release(&handler->handles, entry->id);
+
+	/* A disarm request still on the submission queue is embedded on the entry, which is retired once the
+	 * request is drained.
+	 */
+	if ((deferred = entry->cancel_queued))
+		entry->released = 1;
+
+	_submit_unlock(handler);
+
+	if (!deferred)
+		_entry_retire(handler, entry);
+}
+
+/* Applies the requests submitted without the event mutex, in submission order. Called with the event mutex
+ * held, before the next deadline is computed.
+ */
+void psched_submit_drain(psched_t *handler) {
+	struct psched_submit *request = NULL;
+	struct psched_entry *entry = NULL;
+	int cancelled = 0, released = 0;
+
+	while ((request = submit_pop(&handler->submitq))) {
+		entry = request->entry;
+
+		pthread_mutex_lock(&handler->submit_mutex);
+
+		cancelled = entry->cancelled;
+
+		if (request->type == SUBMIT_ARM) {
+			entry->submitted = 0;
+		} else {
+			entry->cancel_queued = 0;
+			released = entry->released;
+		}
+
+		pthread_mutex_unlock(&handler->submit_mutex);
+
+		/* Disarm requests of entries that were already removed only retire them */
+		if (request->type == SUBMIT_DISARM) {
+			if (released)
+				_entry_retire(handler, entry);
+			else if (!entry->to_remove)
+				_disarm(handler, entry);
+
 			continue;
+		}
 
-		if (!handler->armed) {
-			handler->armed = entry;
-		} else if (entry->trigger.tv_sec < handler->armed->trigger.tv_sec) {
-			handler->armed = entry;
-		} else if (entry->trigger.tv_sec == handler->armed->trigger.tv_sec) {
-			if (entry->trigger.tv_nsec < handler->armed->trigger.tv_nsec)
-				handler->armed = entry;
+		/* Entries disarmed before being queued are dropped. The arm succeeded all the same, so it's
+		 * accounted along with the disarm.
+		 */
+		if (cancelled) {
+			psched_entry_release(handler, entry);
+
+			handler->counters.arms ++;
+			handler->counters.disarms ++;
+
+			continue;
 		}
+
+		/* The request is embedded on the entry, which is released on failure */
+		if (_entry_queue(handler, entry, request->group) < 0)
+			continue;
+
+		handler->counters.arms ++;
 	}
+}
+
+static int _update_timers(psched_t *handler) {
+	struct itimerspec its;
+	int next = 0;
+
+	memset(&its, 0, sizeof(struct itimerspec));
+
+	/* Fetch the earliest deadline from the scheduling queue */
+	next = queue_next(handler, &its.it_value);
 
-	/* Validate if there's at least one timer to be armed */
-	if (!handler->armed)
+	/* Nothing to do if the timer is already programmed for this deadline (or already disarmed) */
+	if (handler->submit) {
+		/* Submitters may have re-programmed the timer, so only the published deadline is trusted */
+		if (__atomic_load_n(&handler->armed_ns, __ATOMIC_SEQ_CST) == (next ? timespec_to_ns(&its.it_value) : 0))
+			return 0;
+	} else if ((next == handler->armed) && (!next || !timespec_cmp(&its.it_value, &handler->armed_trigger))) {
 		return 0;
+	}
 
-	its.it_value.tv_sec = handler->armed->trigger.tv_sec;
-	its.it_value.tv_nsec = handler->armed->trigger.tv_nsec;
+	/* A single call either re-arms the timer to the new deadline or disarms it if the queue is empty */
+	handler->counters.timer_updates ++;
 
-	if (timer_settime(handler->timer, TIMER_ABSTIME, &its, NULL) < 0)
+	if (handler->pollable) {
+		if (fd_settime(handler, &its) < 0)
+			return -1;
+	} else if (timer_settime(handler->timer, TIMER_ABSTIME, &its, NULL) < 0) {
 		return -1;
+	}
+
+	handler->armed = next;
+
+	memcpy(&handler->armed_trigger, &its.it_value, sizeof(struct timespec));
+
+	if (handler->submit)
+		__atomic_store_n(&handler->armed_ns, next ? timespec_to_ns(&its.it_value) : 0, __ATOMIC_SEQ_CST);
 
 	/* All good */
 	return 0;
 }
 
+int psched_update_timers(psched_t *handler) {
+	int ret = 0;
+
+	/* Check if the handler is being destroyed */
+	if (handler->destroy)
+		return 0;
+
+	if (!handler->submit)
+		return _update_timers(handler);
+
+	/* A request pushed while the timer was being programmed may have had its earlier deadline overridden,
+	 * so keep going until the submission queue is found empty after programming the timer.
+	 */
+	do {
+		psched_submit_drain(handler);
+
+		pthread_mutex_lock(&handler->timer_mutex);
 
+		ret = _update_timers(handler);
+
+		pthread_mutex_unlock(&handler->timer_mutex);
+	} while (!ret && !submit_empty(&handler->submitq));
+
+	return ret;
+}
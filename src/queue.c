@@ -0,0 +1,164 @@
+/**
+ * @file queue.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Scheduling queue interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include "heap.h"
+#include "psched.h"
+#include "queue.h"
+#include "seqcount.h"
+#include "timespec.h"
+#include "wheel.h"
+
+int queue_init(psched_t *handler, const psched_attr_t *attr) {
+	struct timespec now;
+
+	handler->backend = attr->backend;
+
+	switch (handler->backend) {
+		case PSCHED_BACKEND_HEAP: {
+			return heap_init(&handler->heap, attr->entries);
+		}
+		case PSCHED_BACKEND_WHEEL: {
+			if (clock_gettime(handler->clockid, &now) < 0)
+				return -1;
+
+			if (!(handler->wheel = wheel_init(&now, &attr->tick)))
+				return -1;
+
+			return 0;
+		}
+	}
+
+	errno = EINVAL;
+
+	return -1;
+}
+
+void queue_destroy(psched_t *handler) {
+	switch (handler->backend) {
+		case PSCHED_BACKEND_HEAP: heap_destroy(&handler->heap); break;
+		case PSCHED_BACKEND_WHEEL: wheel_destroy(handler->wheel); break;
+	}
+}
+
+int queue_insert(psched_t *handler, struct psched_entry *entry) {
+	/* Entries are ordered by the latest time they may fire */
+	entry->deadline = entry->trigger;
+	timespec_add(&entry->deadline, &entry->slack);
+
+	switch (handler->backend) {
+		case PSCHED_BACKEND_HEAP: {
+			if (heap_insert(&handler->heap, entry) < 0)
+				return -1;
+
+			break;
+		}
+		case PSCHED_BACKEND_WHEEL: wheel_insert(handler->wheel, entry); break;
+	}
+
+	handler->counters.queued ++;
+
+	return 0;
+}
+
+void queue_remove(psched_t *handler, struct psched_entry *entry) {
+	switch (handler->backend) {
+		case PSCHED_BACKEND_HEAP: heap_remove(&handler->heap, entry); break;
+		case PSCHED_BACKEND_WHEEL: wheel_remove(handler->wheel, entry); break;
+	}
+
+	handler->counters.queued --;
+}
+
+/* Retrieves the absolute time at which the timer shall be armed. Returns 0 if the queue is empty. */
+int queue_next(psched_t *handler, struct timespec *deadline) {
+	struct psched_entry *entry = NULL;
+
+	switch (handler->backend) {
+		case PSCHED_BACKEND_HEAP: {
+			if (!(entry = heap_top(&handler->heap)))
+				return 0;
+
+			*deadline = entry->deadline;
+
+			return 1;
+		}
+		case PSCHED_BACKEND_WHEEL: {
+			return wheel_next(handler->wheel, deadline);
+		}
+	}
+
+	return 0;
+}
+
+/* Dequeues the next entry that is due at 'now', if any. Entries whose trigger was reached are dequeued ahead
+ * of their deadline while they're found at the head of the queue, so entries with slack share the wakeup.
+ */
+struct psched_entry *queue_pop(psched_t *handler, const struct timespec *now) {
+	struct psched_entry *entry = NULL;
+
+	for (;;) {
+		switch (handler->backend) {
+			case PSCHED_BACKEND_HEAP: {
+				if (!(entry = heap_top(&handler->heap)) || (timespec_cmp(&entry->trigger, now) > 0))
+					return NULL;
+
+				heap_remove(&handler->heap, entry);
+
+				break;
+			}
+			case PSCHED_BACKEND_WHEEL: {
+				if (!(entry = wheel_pop(handler->wheel, now)))
+					return NULL;
+
+				break;
+			}
+		}
+
+		handler->counters.queued --;
+
+		if (!entry->touched)
+			return entry;
+
+		/* Entries touched while queued (see psched_touch()) are only moved once they reach the head */
+		seqcount_write_begin(&entry->seq);
+		entry->trigger = entry->touch;
+		entry->touched = 0;
+		seqcount_write_end(&entry->seq);
+
+		if (timespec_cmp(&entry->trigger, now) <= 0)
+			return entry;
+
+		/* If it can't be queued again, the entry is handed over as is and, since its trigger wasn't
+		 * reached, queued again once the batch is processed.
+		 */
+		if (queue_insert(handler, entry) < 0)
+			return entry;
+	}
+}
+
@@ -0,0 +1,57 @@
+/**
+ * @file seqcount.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Sequence counter interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "seqcount.h"
+
+void seqcount_write_begin(unsigned int *seq) {
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+
+	/* The odd counter must be visible before any of the updated data */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void seqcount_write_end(unsigned int *seq) {
+	__atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+unsigned int seqcount_read_begin(const unsigned int *seq) {
+	unsigned int start = 0;
+
+	/* Wait for an update in progress to complete */
+	while ((start = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+
+	return start;
+}
+
+/* Checks if the data copied since seqcount_read_begin() may be inconsistent */
+int seqcount_read_retry(const unsigned int *seq, unsigned int start) {
+	/* The data must be copied before the counter is read again */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
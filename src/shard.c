@@ -0,0 +1,320 @@
+/**
+ * @file shard.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Sharded scheduler interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "handle.h"
+#include "histogram.h"
+#include "mm.h"
+#include "psched.h"
+#include "timespec.h"
+
+/* Statics */
+static psched_t *_shard_of_thread(psched_sharded_t *sharded, unsigned int *shard) {
+	uintptr_t val = (uintptr_t) pthread_getspecific(sharded->key);
+
+	/* Threads are assigned to the shards in a round-robin fashion on their first arm */
+	if (!val) {
+		pthread_mutex_lock(&sharded->mutex);
+		val = (sharded->next ++ % sharded->nshards) + 1;
+		pthread_mutex_unlock(&sharded->mutex);
+
+		pthread_setspecific(sharded->key, (void *) val);
+	}
+
+	*shard = val - 1;
+
+	return sharded->shards[*shard];
+}
+
+static psched_t *_shard_of_id(psched_sharded_t *sharded, pschedid_t id) {
+	uintptr_t shard = id >> PSCHED_HANDLE_SHARD_SHIFT;
+
+	if (shard >= sharded->nshards) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return sharded->shards[shard];
+}
+
+static pschedid_t _shard_id(pschedid_t id, unsigned int shard) {
+	if (id == (pschedid_t) -1)
+		return id;
+
+	return id | ((pschedid_t) shard << PSCHED_HANDLE_SHARD_SHIFT);
+}
+
+/* API */
+psched_sharded_t *psched_sharded_init(unsigned int nshards, const psched_attr_t *attr) {
+	int errsv = 0;
+	psched_sharded_t *sharded = NULL;
+
+	if (!nshards || (nshards > (1U << PSCHED_HANDLE_SHARD_BITS))) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (!(sharded = mm_alloc(sizeof(psched_sharded_t))))
+		return NULL;
+
+	memset(sharded, 0, sizeof(psched_sharded_t));
+
+	if (!(sharded->shards = mm_alloc(sizeof(psched_t *) * nshards))) {
+		errsv = errno;
+		goto _init_failure_shards;
+	}
+
+	if ((errsv = pthread_key_create(&sharded->key, NULL)))
+		goto _init_failure_key;
+
+	if ((errsv = pthread_mutex_init(&sharded->mutex, NULL)))
+		goto _init_failure_mutex;
+
+	/* Each shard is an independent threaded handler, with its own lock and timer */
+	for (sharded->nshards = 0; sharded->nshards < nshards; sharded->nshards ++) {
+		if (!(sharded->shards[sharded->nshards] = psched_thread_init_ex(attr))) {
+			errsv = errno;
+			goto _init_failure_handlers;
+		}
+	}
+
+	return sharded;
+
+_init_failure_handlers:
+	while (sharded->nshards --) {
+		if (!psched_destroy(sharded->shards[sharded->nshards]))
+			psched_handler_destroy(sharded->shards[sharded->nshards]);
+	}
+
+	pthread_mutex_destroy(&sharded->mutex);
+
+_init_failure_mutex:
+	pthread_key_delete(sharded->key);
+
+_init_failure_key:
+	mm_free(sharded->shards);
+
+_init_failure_shards:
+	mm_free(sharded);
+
+	errno = errsv;
+
+	return NULL;
+}
+
+int psched_sharded_destroy(psched_sharded_t *sharded) {
+	unsigned int i = 0;
+	int ret = 0;
+
+	/* A shard that failed to be destroyed may still be referenced by its timer, so its memory is kept */
+	for (i = 0; i < sharded->nshards; i ++) {
+		if (psched_destroy(sharded->shards[i]) < 0) {
+			ret = -1;
+			continue;
+		}
+
+		psched_handler_destroy(sharded->shards[i]);
+	}
+
+	pthread_mutex_destroy(&sharded->mutex);
+	pthread_key_delete(sharded->key);
+
+	mm_free(sharded->shards);
+	mm_free(sharded);
+
+	return ret;
+}
+
+pschedid_t psched_sharded_arm(
+		psched_sharded_t *sharded,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr)
+{
+	unsigned int shard = 0;
+	psched_t *handler = _shard_of_thread(sharded, &shard);
+
+	return _shard_id(psched_timespec_arm_ex(handler, trigger, step, expire, routine, arg, attr), shard);
+}
+
+pschedid_t psched_sharded_arm_in(
+		psched_sharded_t *sharded,
+		struct timespec *delay,
+		struct timespec *step,
+		struct timespec *expire,
+		void (*routine) (void *),
+		void *arg,
+		const psched_arm_attr_t *attr)
+{
+	unsigned int shard = 0;
+	psched_t *handler = _shard_of_thread(sharded, &shard);
+
+	return _shard_id(psched_timespec_arm_in(handler, delay, step, expire, routine, arg, attr), shard);
+}
+
+int psched_sharded_disarm(psched_sharded_t *sharded, pschedid_t id) {
+	psched_t *handler = NULL;
+
+	if (!(handler = _shard_of_id(sharded, id)))
+		return -1;
+
+	/* The handle table ignores the shard bits */
+	return psched_disarm(handler, id);
+}
+
+int psched_sharded_search(
+		psched_sharded_t *sharded,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire)
+{
+	psched_t *handler = NULL;
+
+	if (!(handler = _shard_of_id(sharded, id)))
+		return -1;
+
+	return psched_search(handler, id, trigger, step, expire);
+}
+
+int psched_sharded_rearm(
+		psched_sharded_t *sharded,
+		pschedid_t id,
+		struct timespec *trigger,
+		struct timespec *step,
+		struct timespec *expire)
+{
+	psched_t *handler = NULL;
+
+	if (!(handler = _shard_of_id(sharded, id)))
+		return -1;
+
+	return psched_rearm(handler, id, trigger, step, expire);
+}
+
+int psched_sharded_touch(psched_sharded_t *sharded, pschedid_t id, struct timespec *delay) {
+	psched_t *handler = NULL;
+
+	if (!(handler = _shard_of_id(sharded, id)))
+		return -1;
+
+	return psched_touch(handler, id, delay);
+}
+
+int psched_sharded_overrun(psched_sharded_t *sharded, pschedid_t id) {
+	psched_t *handler = NULL;
+
+	if (!(handler = _shard_of_id(sharded, id)))
+		return -1;
+
+	return psched_overrun(handler, id);
+}
+
+/* Retrieves the earliest deadline over all the shards. Returns 0 if no entry is armed. */
+int psched_sharded_next_deadline(psched_sharded_t *sharded, struct timespec *deadline) {
+	struct timespec next;
+	unsigned int i = 0;
+	int found = 0;
+
+	for (i = 0; i < sharded->nshards; i ++) {
+		if (psched_next_deadline(sharded->shards[i], &next) && (!found || (timespec_cmp(&next, deadline) < 0))) {
+			memcpy(deadline, &next, sizeof(struct timespec));
+			found = 1;
+		}
+	}
+
+	return found;
+}
+
+/* Sums the counters of all the shards */
+int psched_sharded_counters_get(psched_sharded_t *sharded, psched_counters_t *counters) {
+	psched_counters_t shard;
+	unsigned int i = 0;
+
+	memset(counters, 0, sizeof(psched_counters_t));
+
+	for (i = 0; i < sharded->nshards; i ++) {
+		psched_counters_get(sharded->shards[i], &shard);
+
+		counters->wakeups += shard.wakeups;
+		counters->wakeups_saved += shard.wakeups_saved;
+		counters->arms += shard.arms;
+		counters->disarms += shard.disarms;
+		counters->fires += shard.fires;
+		counters->reschedules += shard.reschedules;
+		counters->expired += shard.expired;
+		counters->timer_updates += shard.timer_updates;
+		counters->missed += shard.missed;
+		counters->lock_wait += shard.lock_wait;
+		counters->queued += shard.queued;
+	}
+
+	return 0;
+}
+
+/* Enables or disables the latency histograms of all the shards */
+int psched_sharded_stats_enable(psched_sharded_t *sharded, int enable) {
+	unsigned int i = 0;
+
+	for (i = 0; i < sharded->nshards; i ++)
+		psched_stats_enable(sharded->shards[i], enable);
+
+	return 0;
+}
+
+/* Summarizes the latency histograms of all the shards merged together, so the percentiles cover every entry.
+ * The result can be rendered with psched_stats_prometheus(), as the one of a single handler.
+ */
+int psched_sharded_stats_snapshot(psched_sharded_t *sharded, psched_stats_t *stats) {
+	struct psched_histogram lateness, runtime;
+	unsigned int i = 0;
+
+	memset(&lateness, 0, sizeof(struct psched_histogram));
+	memset(&runtime, 0, sizeof(struct psched_histogram));
+
+	for (i = 0; i < sharded->nshards; i ++) {
+		histogram_merge(&lateness, &sharded->shards[i]->lateness);
+		histogram_merge(&runtime, &sharded->shards[i]->runtime);
+	}
+
+	psched_stats_summarize(stats, &lateness, &runtime);
+
+	return 0;
+}
+
+int psched_sharded_stats_get(psched_sharded_t *sharded, psched_stats_t *stats) {
+	psched_sharded_counters_get(sharded, &stats->counters);
+
+	return psched_sharded_stats_snapshot(sharded, stats);
+}
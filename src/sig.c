@@ -33,6 +33,6 @@
 void sig_handler(int sig, siginfo_t *si, void *context) {
 	psched_t *handler = (psched_t *) si->si_value.sival_ptr;
 
-	event_process(handler);
+	event_process(handler, 0);
 }
 
@@ -0,0 +1,91 @@
+/**
+ * @file submit.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Submission queue interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <stddef.h>
+
+#include "submit.h"
+
+void submit_init(struct psched_submitq *q) {
+	q->stub.next = NULL;
+	q->head = &q->stub;
+	q->tail = &q->stub;
+}
+
+void submit_push(struct psched_submitq *q, struct psched_submit *node) {
+	struct psched_submit *prev = NULL;
+
+	__atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+
+	/* Claim the head, then link the previous one to us. Until the link is stored, the consumer sees the
+	 * queue as ending at 'prev'.
+	 */
+	prev = __atomic_exchange_n(&q->head, node, __ATOMIC_ACQ_REL);
+
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/* Pops the oldest request. Returns NULL if the queue is empty, or if the oldest request is still being
+ * pushed, in which case it's popped by a later call.
+ */
+struct psched_submit *submit_pop(struct psched_submitq *q) {
+	struct psched_submit *tail = q->tail, *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+	/* Skip the stub */
+	if (tail == &q->stub) {
+		if (!next)
+			return NULL;
+
+		q->tail = next;
+		tail = next;
+		next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+	}
+
+	if (next) {
+		q->tail = next;
+
+		return tail;
+	}
+
+	/* A push is in progress */
+	if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	/* This is the last request. Push the stub behind it, so it can be unlinked. */
+	submit_push(q, &q->stub);
+
+	if ((next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE))) {
+		q->tail = next;
+
+		return tail;
+	}
+
+	return NULL;
+}
+
+int submit_empty(struct psched_submitq *q) {
+	return __atomic_load_n(&q->head, __ATOMIC_SEQ_CST) == q->tail && q->tail == &q->stub;
+}
@@ -24,14 +24,31 @@
  *
  */
 
+#ifdef __linux__
+ #define _GNU_SOURCE	/* pthread_attr_setaffinity_np() */
+#endif
+
+#include <string.h>
+#include <errno.h>
 #include <signal.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 #include "psched.h"
 #include "event.h"
-#include "mm.h"
+#include "thread.h"
+#include "timespec.h"
+
+/* Statics */
+static void *_thread_probe(void *arg) {
+	return arg;
+}
+
+int thread_init(psched_t *handler, const psched_attr_t *attr) {
+	if (thread_attr_init(&handler->thread_attr, attr) < 0)
+		return -1;
 
-int thread_init(psched_t *handler) {
 	if (pthread_mutex_init(&handler->event_mutex, NULL))
 		return -1;
 
@@ -44,15 +61,132 @@ int thread_init(psched_t *handler) {
 void thread_destroy(psched_t *handler) {
 	pthread_mutex_destroy(&handler->event_mutex);
 	pthread_cond_destroy(&handler->event_cond);
+	pthread_attr_destroy(&handler->thread_attr);
+}
+
+/* Returns 1 if any thread attribute differs from the defaults */
+int thread_attr_custom(const psched_attr_t *attr) {
+	unsigned int i = 0;
+
+	if (attr->stacksize || (attr->policy != SCHED_OTHER))
+		return 1;
+
+	for (i = 0; i < PSCHED_AFFINITY_WORDS; i ++) {
+		if (attr->affinity[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+int thread_attr_init(pthread_attr_t *pattr, const psched_attr_t *attr) {
+	int errsv = 0;
+	unsigned int cpu = 0;
+	struct sched_param param;
+	pthread_t probe;
+#ifdef __linux__
+	cpu_set_t cpuset;
+#endif
+
+	if ((errsv = pthread_attr_init(pattr))) {
+		errno = errsv;
+		return -1;
+	}
+
+	if (attr->stacksize && (errsv = pthread_attr_setstacksize(pattr, attr->stacksize)))
+		goto _attr_failure;
+
+	/* Real-time scheduling must be set explicitly, as it isn't inherited from the creating thread */
+	if (attr->policy != SCHED_OTHER) {
+		if ((attr->policy != SCHED_FIFO) && (attr->policy != SCHED_RR)) {
+			errsv = EINVAL;
+			goto _attr_failure;
+		}
+
+		memset(&param, 0, sizeof(struct sched_param));
+
+		param.sched_priority = attr->priority;
+
+		if ((errsv = pthread_attr_setinheritsched(pattr, PTHREAD_EXPLICIT_SCHED)))
+			goto _attr_failure;
+
+		if ((errsv = pthread_attr_setschedpolicy(pattr, attr->policy)))
+			goto _attr_failure;
+
+		if ((errsv = pthread_attr_setschedparam(pattr, &param)))
+			goto _attr_failure;
+	}
+
+#ifdef __linux__
+	CPU_ZERO(&cpuset);
+#endif
+
+	for (cpu = 0; cpu < (PSCHED_AFFINITY_WORDS * 64); cpu ++) {
+		if (!(attr->affinity[cpu / 64] & ((uint64_t) 1 << (cpu % 64))))
+			continue;
+
+#ifdef __linux__
+		if (cpu >= CPU_SETSIZE) {
+			errsv = EINVAL;
+			goto _attr_failure;
+		}
+
+		CPU_SET(cpu, &cpuset);
+#else
+		/* No portable way to set the CPU affinity */
+		errsv = ENOTSUP;
+		goto _attr_failure;
+#endif
+	}
+
+#ifdef __linux__
+	if (CPU_COUNT(&cpuset) && (errsv = pthread_attr_setaffinity_np(pattr, sizeof(cpu_set_t), &cpuset)))
+		goto _attr_failure;
+#endif
+
+	/* Attributes that are only checked when a thread is created, such as a real-time policy without the
+	 * required privileges, would otherwise make every notification thread fail to start, silently.
+	 */
+	if (thread_attr_custom(attr)) {
+		if ((errsv = pthread_create(&probe, pattr, &_thread_probe, NULL)))
+			goto _attr_failure;
+
+		pthread_join(probe, NULL);
+	}
+
+	return 0;
+
+_attr_failure:
+	pthread_attr_destroy(pattr);
+
+	errno = errsv;
+
+	return -1;
+}
+
+/* Acquires the event mutex, accounting the time spent waiting for it */
+void thread_lock(psched_t *handler) {
+	struct timespec start, end;
+
+	/* Uncontended acquisitions aren't timed */
+	if (!pthread_mutex_trylock(&handler->event_mutex))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pthread_mutex_lock(&handler->event_mutex);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	timespec_sub(&end, &start);
+
+	handler->counters.lock_wait += timespec_to_ns(&end);
 }
 
 void thread_handler(union sigval sv) {
 	psched_t *handler = sv.sival_ptr;
 
-	event_process(handler);
-
-	/* Check if handler is set to be destroyed */
-	if (!handler->armed && handler->destroy)
-		mm_free(handler);
+	/* The handler memory is released by psched_handler_destroy() */
+	event_process(handler, 0);
 }
 
@@ -24,6 +24,10 @@
  *
  */
 
+#ifdef __linux__
+ #define _GNU_SOURCE	/* pthread_attr_setaffinity_np() */
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -31,255 +35,559 @@
 #include <errno.h>
 #include <signal.h>
 #include <time.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/select.h>
 
+#include "exec.h"
 #include "timer_ul.h"
 #include "mm.h"
 #include "timespec.h"
 
+/* Depends on the engine selection performed by timer_ul.h */
+#ifdef PSCHED_TIMER_UL_TIMERFD
+ #include <sys/epoll.h>
+ #include <sys/timerfd.h>
+#endif
+
 /* Globals */
-static struct timer_ul *_timers = NULL;
-static size_t _nr_timers = 0;
-static pthread_mutex_t _mutex_timers = PTHREAD_MUTEX_INITIALIZER;
+static struct timer_ul *_pages[PSCHED_TIMER_UL_PAGES];	/* Slot pages. Once allocated, never moved nor freed */
+static size_t _nr_pages = 0;
+static struct timer_ul *_free = NULL;
+static pthread_mutex_t _mutex_slots = PTHREAD_MUTEX_INITIALIZER;	/* Slot allocation and lazy initialization */
+static size_t _nr_notify = 0;		/* Notification threads, one per SIGEV_THREAD timer */
+static pthread_attr_t _thread_attr;	/* Attributes of every thread created by the userland timers */
+static int _thread_attr_init = 0;
+
+/* Service engine: one thread per clock, sleeping until the earliest deadline of the timers armed on that
+ * clock, which are kept on a min-heap.
+ */
+static struct timer_ul_service _services[PSCHED_TIMER_UL_SERVICES] = {
+	{ 0, CLOCK_REALTIME, PTHREAD_MUTEX_INITIALIZER },
+	{ 0, CLOCK_MONOTONIC, PTHREAD_MUTEX_INITIALIZER }
+};
+
+#ifdef PSCHED_TIMER_UL_TIMERFD
+static int _epoll_fd = -1;
+static unsigned int _timers_gen = 0;
+#endif
 
-static void *_notify_routine(void *arg) {
-	struct sigevent sevp;
+/* Accounts expirations that weren't notified, saturating at DELAYTIMER_MAX. Called with the lock of the engine
+ * delivering the expirations held.
+ */
+static void _overrun_add(struct timer_ul *timer, uint64_t count) {
+	if (count >= (uint64_t) (DELAYTIMER_MAX - timer->overruns))
+		timer->overruns = DELAYTIMER_MAX;
+	else
+		timer->overruns += count;
+}
 
-	memcpy(&sevp, arg, sizeof(struct sigevent));
+static void _notify_routine(void *arg) {
+	struct timer_ul *timer = arg;
 
-	sevp.sigev_notify_function(sevp.sigev_value);
+	/* The overruns accounted so far belong to this notification, which is now being delivered */
+	pthread_mutex_lock(&timer->mutex);
 
-	pthread_exit(NULL);
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_SERVICE)
+		pthread_mutex_lock(&timer->service->mutex);
 
-	return NULL;
+	timer->overrun = timer->overruns;
+	timer->overruns = 0;
+
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_SERVICE)
+		pthread_mutex_unlock(&timer->service->mutex);
+
+	pthread_mutex_unlock(&timer->mutex);
+
+	timer->notify.sevp.sigev_notify_function(timer->notify.sevp.sigev_value);
 }
 
-static int _fd_set_nonblock(int fd) {
-#ifdef COMPILE_WIN32
+static void _notify(struct timer_ul *timer) {
+	/* Invoke notification */
+	switch (timer->notify.sevp.sigev_notify) {
+		case SIGEV_THREAD: {
+			/* Hand the notification to the persistent notification thread of the timer. If the
+			 * previous notification of this timer is still queued, this expiration is an overrun.
+			 */
+			if (exec_submit(&timer->notify.exec, &timer->notify.work) < 0)
+				_overrun_add(timer, 1);
+		} break;
+		case SIGEV_NONE: {
+		} break;
+		default: {
+			/* Something went wrong... we don't recognize this state */
+			abort();
+		}
+	}
+}
+
+static pthread_attr_t *_thread_attr_get(void) {
+	if (_thread_attr_init)
+		return &_thread_attr;
+
+	if (pthread_attr_init(&_thread_attr))
+		return NULL;
+
+	if (PSCHED_TIMER_UL_SERVICE_STACKSIZE)
+		pthread_attr_setstacksize(&_thread_attr, PSCHED_TIMER_UL_SERVICE_STACKSIZE);
+
+	_thread_attr_init = 1;
+
+	return &_thread_attr;
+}
+
+static int _thread_attr_busy(void) {
+	/* Thread attributes can only be changed before any thread is created */
+	if (_nr_notify || _services[PSCHED_TIMER_UL_SERVICE_REALTIME].init || _services[PSCHED_TIMER_UL_SERVICE_MONOTONIC].init)
+		return 1;
+
+#ifdef PSCHED_TIMER_UL_TIMERFD
+	if (_epoll_fd >= 0)
+		return 1;
+#endif
+
 	return 0;
-#else
-	int flags = 0;
+}
 
-	if ((flags = fcntl(fd, F_GETFL)) < 0)
+static int _thread_create(void *(*routine) (void *), void *arg) {
+	int errsv = 0;
+	pthread_t t_id;
+
+	if ((errsv = pthread_create(&t_id, _thread_attr_get(), routine, arg))) {
+		errno = errsv;
 		return -1;
+	}
 
-	if (!(flags & O_NONBLOCK)) {
-		if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
-			return -1;
+	pthread_detach(t_id);
+
+	return 0;
+}
+
+static struct timer_ul *_slot_get(size_t slot) {
+	if ((slot >> PSCHED_TIMER_UL_PAGE_BITS) >= PSCHED_TIMER_UL_PAGES)
+		return NULL;
+
+	if (!_pages[slot >> PSCHED_TIMER_UL_PAGE_BITS])
+		return NULL;
+
+	return &_pages[slot >> PSCHED_TIMER_UL_PAGE_BITS][slot & (PSCHED_TIMER_UL_PAGE_SLOTS - 1)];
+}
+
+static int _slot_grow(void) {
+	size_t i = 0;
+	struct timer_ul *page = NULL;
+
+	if (_nr_pages == PSCHED_TIMER_UL_PAGES) {
+		errno = EAGAIN;
+		return -1;
 	}
 
+	if (!(page = mm_alloc(sizeof(struct timer_ul) * PSCHED_TIMER_UL_PAGE_SLOTS)))
+		return -1;
+
+	memset(page, 0, sizeof(struct timer_ul) * PSCHED_TIMER_UL_PAGE_SLOTS);
+
+	/* Push the new slots into the free list, so the lowest slots are used first */
+	for (i = PSCHED_TIMER_UL_PAGE_SLOTS; i > 0; i --) {
+		pthread_mutex_init(&page[i - 1].mutex, NULL);
+
+		page[i - 1].slot = (_nr_pages << PSCHED_TIMER_UL_PAGE_BITS) + i - 1;
+
+		page[i - 1].free_next = _free;
+		_free = &page[i - 1];
+	}
+
+	_pages[_nr_pages ++] = page;
+
 	return 0;
-#endif
 }
 
-static void *_timer_process(void *arg) {
-	struct timer_ul *timer = arg;
-	struct timespec tcur, tsleep, tv_start, tv_stop, tv_delta;
-	struct timeval wait_val;
-	pthread_t t_notify;
+static struct timer_ul *_timer_lock(timer_t timerid) {
+	struct timer_ul *timer = NULL;
 
-	/* Acquire the lock */
-	pthread_mutex_lock(&timer->t_mutex);
+	/* Sanity check */
+	if (!timerid || !(timer = _slot_get(((uintptr_t) timerid) - 1))) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	pthread_mutex_lock(&timer->mutex);
+
+	/* The slot may be free, or reused by another timer */
+	if (timer->id != timerid) {
+		pthread_mutex_unlock(&timer->mutex);
+		errno = EINVAL;
+		return NULL;
+	}
 
-	/* Mark the timer as ARMED */
-	timer->t_flags |= PSCHED_TIMER_UL_THREAD_INIT_FLAG;
+	return timer;
+}
+
+static int _service_cmp(struct timer_ul_service *service, size_t a, size_t b) {
+	return timespec_cmp(&service->heap[a]->deadline, &service->heap[b]->deadline);
+}
 
-	/* Inform that this timer is now armed. NOTE: The mutex release is present before select() */
-	pthread_cond_signal(&timer->t_cond_h);
+static void _service_swap(struct timer_ul_service *service, size_t a, size_t b) {
+	struct timer_ul *tmp = service->heap[a];
 
+	service->heap[a] = service->heap[b];
+	service->heap[b] = tmp;
+
+	service->heap[a]->heap_pos = a + 1;
+	service->heap[b]->heap_pos = b + 1;
+}
+
+static void _service_heap_fix(struct timer_ul_service *service, size_t i) {
+	size_t child = 0;
+
+	/* Sift up */
+	while (i && (_service_cmp(service, i, (i - 1) / 2) < 0)) {
+		_service_swap(service, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+
+	/* Sift down */
 	for (;;) {
-		/* Do not proceed if this timer has nothing to do (disarmed) */
-		while (!(timer->t_flags & PSCHED_TIMER_UL_THREAD_ARMED_FLAG))
-			pthread_cond_wait(&timer->t_cond_p, &timer->t_mutex);
-
-		/* Timer is no longer in initializing state */
-		timer->t_flags &= ~PSCHED_TIMER_UL_THREAD_INIT_FLAG;
-		pthread_cond_signal(&timer->t_cond_h);
-
-		/* Evaluate timer state */
-		if ((timer->rem.tv_sec <= 0) && (timer->rem.tv_nsec <= 0)) {
-			memset(&timer->rem, 0, sizeof(struct timespec));
-
-			/* Process timer based on flags */
-			if (timer->flags & TIMER_ABSTIME) {
-				/* If absolute ... */
-				memcpy(&tsleep, &timer->arm.it_value, sizeof(struct timespec));
-
-				/* If we can't retrieve current time, there's no point in
-				 * continuing
-				 */
-				/* TODO: use some alternatives to clock_gettime() if it fails. */
-				if (clock_gettime(timer->clockid, &tcur) < 0)
-					abort();
-
-				/* Subtract the current time to the absolute value of the timer */
-				timespec_sub(&tsleep, &tcur);
-			} else {
-				/* If relative ... */
-				memcpy(&tsleep, &timer->arm.it_value, sizeof(struct timespec));
-			}
-		} else {
-			/* If there's time left to wait ... */
-			memcpy(&tsleep, &timer->rem, sizeof(struct timespec));
-		}
+		child = (i * 2) + 1;
+
+		if (child >= service->count)
+			break;
 
-		/* Prepare parameters for select() */
-		FD_ZERO(&timer->wait_set);
-		FD_SET(timer->wait_pipe[0], &timer->wait_set);
+		if (((child + 1) < service->count) && (_service_cmp(service, child + 1, child) < 0))
+			child ++;
 
-		wait_val.tv_sec = tsleep.tv_sec;
-		wait_val.tv_usec = tsleep.tv_nsec / 1000;
+		if (_service_cmp(service, i, child) <= 0)
+			break;
 
-		/* Release the timer mutex while the timer is blocking */
-		pthread_mutex_unlock(&timer->t_mutex);
+		_service_swap(service, i, child);
+		i = child;
+	}
+}
 
-		/* Snapshot the current time */
-		clock_gettime(CLOCK_REALTIME, &tv_start); /* TODO: Alternatives? */
+static int _service_heap_insert(struct timer_ul_service *service, struct timer_ul *timer) {
+	struct timer_ul **heap = NULL;
 
-		/* Wait for timeout or some event on the pipe */
-		if (select(timer->wait_pipe[0] + 1, &timer->wait_set, NULL, NULL, &wait_val) < 0) {
-			/* 'wait_set' is unreliable from now on ... */
-			;
-		}
+	if (service->count == service->size) {
+		if (!(heap = mm_realloc(service->heap, sizeof(struct timer_ul *) * (service->size ? service->size * 2 : 16))))
+			return -1;
 
-		/* Take another snapshot of the current time so we can calculate the variation */
-		clock_gettime(CLOCK_REALTIME, &tv_stop); /* TODO: Alternatives? */
-
-		/* Re-acquire the timer mutex */
-		pthread_mutex_lock(&timer->t_mutex);
-
-		/* If something was written on the pipe, an interrupt ocurred */
-		if (FD_ISSET(timer->wait_pipe[0], &timer->wait_set)) {
-			/* On interrupt, we need to calculate how much time is left */
-			memcpy(&timer->rem, &tsleep, sizeof(struct timespec));
-			memcpy(&tv_delta, &tv_stop, sizeof(struct timespec));
-			timespec_sub(&tv_delta, &tv_start);
-			timespec_sub(&timer->rem, &tv_delta);
-
-			/* pipe is O_NONBLOCK as the 'wait_set' may be unreliable */
-			while (read(timer->wait_pipe[0], (char [1]) { 0 }, 1) == 1);
-		} else {
-			/* On timeout return of select(), reset the rem as there's
-			 * nothing to compensate
-			 */
-			memset(&timer->rem, 0, sizeof(struct timespec));
-		}
+		service->heap = heap;
+		service->size = service->size ? service->size * 2 : 16;
+	}
 
-		/* Interrupt flag means urgent restart of the loop to re-evaluate state */
-		if (timer->t_flags & PSCHED_TIMER_UL_THREAD_INTR_FLAG) {
-			timer->t_flags &= ~PSCHED_TIMER_UL_THREAD_INTR_FLAG;
-			pthread_cond_signal(&timer->t_cond_h);
+	service->heap[service->count] = timer;
+	timer->heap_pos = ++ service->count;
 
-			continue;
-		}
+	_service_heap_fix(service, service->count - 1);
 
-		/* If a read operation was performed, signal the reader that it can now read the
-		 * updated values whenever possible.
-		 */
-		if (timer->t_flags & PSCHED_TIMER_UL_THREAD_READ_FLAG) {
-			timer->t_flags &= ~PSCHED_TIMER_UL_THREAD_READ_FLAG;
-			pthread_cond_signal(&timer->t_cond_h);
+	return 0;
+}
+
+static void _service_heap_remove(struct timer_ul_service *service, struct timer_ul *timer) {
+	size_t i = timer->heap_pos - 1;
 
+	if (!timer->heap_pos)
+		return;
+
+	timer->heap_pos = 0;
+
+	if (i == -- service->count)
+		return;
+
+	service->heap[i] = service->heap[service->count];
+	service->heap[i]->heap_pos = i + 1;
+
+	_service_heap_fix(service, i);
+}
+
+static void *_service_process(void *arg) {
+	struct timer_ul_service *service = arg;
+	struct timer_ul *timer = NULL;
+	struct timespec now, deadline, delta;
+	uint64_t interval = 0, missed = 0;
+
+	pthread_mutex_lock(&service->mutex);
+
+	for (;;) {
+		/* Sleep until some timer is armed */
+		if (!service->count) {
+			pthread_cond_wait(&service->cond, &service->mutex);
 			continue;
 		}
 
-		/* Validate if there's time remaining to wait for */
-		if (timer->rem.tv_sec > 0) {
-			continue;
-		} else if (timer->rem.tv_nsec > 0) {
+		timer = service->heap[0];
+
+		/* If we can't retrieve current time, there's no point in continuing */
+		if (clock_gettime(service->clockid, &now) < 0)
+			abort();
+
+		/* Sleep until the earliest deadline, or until the timers are changed. The condition variable
+		 * waits on the service clock, so the absolute deadline is honored with nanosecond resolution.
+		 */
+		if (timespec_cmp(&timer->deadline, &now) > 0) {
+			memcpy(&deadline, &timer->deadline, sizeof(struct timespec));
+			pthread_cond_timedwait(&service->cond, &service->mutex, &deadline);
 			continue;
 		}
 
-		/* Invoke notification */
-		switch (timer->sevp.sigev_notify) {
-			case SIGEV_THREAD: {
-				pthread_create(&t_notify, NULL, &_notify_routine, &timer->sevp);
-				pthread_detach(t_notify);
-			} break;
-			case SIGEV_SIGNAL: {
-				/* TODO: Not yet implemented */
-				abort();
-			} break;
-			case SIGEV_NONE: {
-			} break;
-			default: {
-				/* Something went wrong... we don't recognize this state */
-				abort();
-			}
-		}
+		_service_heap_remove(service, timer);
 
-		/* TODO: Check if overrun occurred. */
+		_notify(timer);
 
-		/* Add the it_interval to it_value, or disarm the timer if no interval is set */
-		if (!timer->arm.it_interval.tv_sec && !timer->arm.it_interval.tv_nsec) {
-			timer->t_flags &= ~PSCHED_TIMER_UL_THREAD_ARMED_FLAG;
+		/* Disarm the timer if no interval is set */
+		if (!timer->interval.tv_sec && !timer->interval.tv_nsec) {
+			timer->armed = 0;
 			continue;
 		}
 
-		/* Update timer value */
-		if (timer->flags & TIMER_ABSTIME) {
-			/* If absolute, add the interval to the current timer value */
-			timespec_add(&timer->arm.it_value, &timer->arm.it_interval);
-		} else {
-			/* If relative, the interval value is the new timer value */
-			memcpy(&timer->arm.it_value, &timer->arm.it_interval, sizeof(struct timespec));
+		/* Move to the next expiration. Expirations that were missed meanwhile are overruns. */
+		timespec_add(&timer->deadline, &timer->interval);
+
+		if (timespec_cmp(&timer->deadline, &now) <= 0) {
+			memcpy(&delta, &now, sizeof(struct timespec));
+			timespec_sub(&delta, &timer->deadline);
+
+			interval = timespec_to_ns(&timer->interval);
+			missed = (timespec_to_ns(&delta) / interval) + 1;
+
+			_overrun_add(timer, missed);
+
+			timespec_from_ns(&delta, missed * interval);
+			timespec_add(&timer->deadline, &delta);
 		}
+
+		/* Can't fail, as the timer was just removed from the heap */
+		_service_heap_insert(service, timer);
 	}
 
 	/* Unreachable */
-	pthread_exit(NULL);
-
 	return NULL;
 }
 
-/* API */
-int timer_create_ul(clockid_t clockid, struct sigevent *sevp, timer_t *timerid) {
-	int i = 0, errsv = 0, slot = -1;
+static int _service_start(struct timer_ul_service *service) {
+	int errsv = 0;
+	pthread_condattr_t attr;
 
-	/* Acquire timers critical region lock */
-	pthread_mutex_lock(&_mutex_timers);
+	if ((errsv = pthread_condattr_init(&attr)))
+		goto _start_failure;
 
-	/* Check if there's a free control slot */
-	for (i = 0; _timers && (i < _nr_timers); i ++) {
-		if (!_timers[i].id) {
-			/* Assign the slot */
-			slot = i;
-			break;
-		} else if (_timers[i].t_flags & PSCHED_TIMER_UL_THREAD_WAIT_FLAG) {
-			/* Thread is waiting to be joined */
-			pthread_join(_timers[i].t_id, NULL);
+	/* Bind the condition variable to the service clock */
+	if (service->clockid != CLOCK_REALTIME) {
+#ifdef PSCHED_TIMER_UL_NO_CONDATTR_CLOCK
+		errsv = ENOTSUP;
+#else
+		errsv = pthread_condattr_setclock(&attr, service->clockid);
+#endif
+		if (errsv) {
+			pthread_condattr_destroy(&attr);
+			goto _start_failure;
+		}
+	}
 
-			/* Assign the slot */
-			slot = i;
-			break;
+	errsv = pthread_cond_init(&service->cond, &attr);
+
+	pthread_condattr_destroy(&attr);
+
+	if (errsv)
+		goto _start_failure;
+
+	if (_thread_create(&_service_process, service) < 0) {
+		errsv = errno;
+		pthread_cond_destroy(&service->cond);
+		goto _start_failure;
+	}
+
+	service->init = 1;
+
+	return 0;
+
+_start_failure:
+	errno = errsv;
+
+	return -1;
+}
+
+static struct timer_ul_service *_service_get(clockid_t clockid) {
+	struct timer_ul_service *service = &_services[PSCHED_TIMER_UL_SERVICE_REALTIME];
+
+	/* Timers on any clock other than CLOCK_REALTIME are served on the monotonic clock, when condition
+	 * variables can wait on it. Otherwise, they're converted to CLOCK_REALTIME deadlines.
+	 */
+	if ((clockid != CLOCK_REALTIME) && (_services[PSCHED_TIMER_UL_SERVICE_MONOTONIC].init ||
+	    !_service_start(&_services[PSCHED_TIMER_UL_SERVICE_MONOTONIC])))
+	{
+		return &_services[PSCHED_TIMER_UL_SERVICE_MONOTONIC];
+	}
+
+	/* Start the service on first use */
+	if (!service->init && (_service_start(service) < 0))
+		return NULL;
+
+	return service;
+}
+
+static void _service_gettime(struct timer_ul *timer, struct itimerspec *curr_value) {
+	struct timespec now;
+
+	memset(curr_value, 0, sizeof(struct itimerspec));
+
+	if (!timer->armed)
+		return;
+
+	memcpy(&curr_value->it_interval, &timer->interval, sizeof(struct timespec));
+	memcpy(&curr_value->it_value, &timer->deadline, sizeof(struct timespec));
+
+	/* Time left until the next expiration (rounded up to 1ns, as 0 means disarmed) */
+	if (clock_gettime(timer->service->clockid, &now) < 0)
+		return;
+
+	timespec_sub(&curr_value->it_value, &now);
+
+	if (!curr_value->it_value.tv_sec && !curr_value->it_value.tv_nsec)
+		curr_value->it_value.tv_nsec = 1;
+}
+
+static int _service_settime(struct timer_ul *timer, int flags, const struct itimerspec *new_value) {
+	struct timer_ul_service *service = timer->service;
+	struct timespec now, rel;
+
+	/* Disarm the timer, if armed */
+	_service_heap_remove(service, timer);
+	timer->armed = 0;
+
+	/* If this is a disarm operation, we're done. The service thread will find out by itself. */
+	if (!new_value->it_value.tv_sec && !new_value->it_value.tv_nsec)
+		return 0;
+
+	if ((flags & TIMER_ABSTIME) && (timer->clockid == service->clockid)) {
+		/* Absolute deadline on the service clock. Used as is. */
+		memcpy(&timer->deadline, &new_value->it_value, sizeof(struct timespec));
+	} else {
+		/* Relative deadline, or absolute on another clock (CPU time, or no monotonic service), which
+		 * is converted into a deadline on the service clock.
+		 */
+		memcpy(&rel, &new_value->it_value, sizeof(struct timespec));
+
+		if (flags & TIMER_ABSTIME) {
+			if (clock_gettime(timer->clockid, &now) < 0)
+				return -1;
+
+			timespec_sub(&rel, &now);
 		}
+
+		if (clock_gettime(service->clockid, &timer->deadline) < 0)
+			return -1;
+
+		timespec_add(&timer->deadline, &rel);
 	}
 
-	/* Check if we've found a free control slot */
-	if (slot == -1) {
-		/* No free slots... allocate a new one */
-		if (!(_timers = mm_realloc(_timers, sizeof(struct timer_ul) * (_nr_timers + 1)))) {
-			pthread_mutex_unlock(&_mutex_timers);
+	memcpy(&timer->interval, &new_value->it_interval, sizeof(struct timespec));
+
+	if (_service_heap_insert(service, timer) < 0)
+		return -1;
+
+	timer->armed = 1;
+
+	/* Wake up the service thread if the earliest deadline changed */
+	if (service->heap[0] == timer)
+		pthread_cond_signal(&service->cond);
 
-			/* Everything will be screwed from now on... */
+	return 0;
+}
+
+#ifdef PSCHED_TIMER_UL_TIMERFD
+static void *_epoll_process(void *arg) {
+	struct epoll_event events[PSCHED_TIMER_UL_EPOLL_EVENTS];
+	struct timer_ul *timer = NULL;
+	uint64_t expirations = 0;
+	int i = 0, nfds = 0;
+
+	for (;;) {
+		/* Wait for any of the timers to expire */
+		if ((nfds = epoll_wait(_epoll_fd, events, PSCHED_TIMER_UL_EPOLL_EVENTS, -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			/* Timers can't be processed from now on... */
 			abort();
 		}
 
-		/* Update our slot index */
-		slot = _nr_timers;
+		for (i = 0; i < nfds; i ++) {
+			/* Slots never move, but the timer may have been deleted since the events were fetched */
+			if (!(timer = _slot_get(events[i].data.u64 & 0xffffffff)))
+				continue;
+
+			pthread_mutex_lock(&timer->mutex);
+
+			/* Fetch and reset the number of expirations. Nothing to do if it was already reset. */
+			if (timer->id && (timer->gen == (events[i].data.u64 >> 32)) &&
+			    (read(timer->tfd, &expirations, sizeof(expirations)) == sizeof(expirations)))
+			{
+				_overrun_add(timer, expirations - 1);
+
+				_notify(timer);
+			}
+
+			pthread_mutex_unlock(&timer->mutex);
+		}
+	}
+
+	/* Unreachable */
+	return NULL;
+}
+
+static int _timerfd_create(struct timer_ul *timer) {
+	int errsv = 0;
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(struct epoll_event));
+
+	/* Start the epoll thread on first use */
+	if (_epoll_fd < 0) {
+		if ((_epoll_fd = epoll_create(PSCHED_TIMER_UL_EPOLL_EVENTS)) < 0)
+			return -1;
+
+		if (_thread_create(&_epoll_process, NULL) < 0) {
+			errsv = errno;
+			close(_epoll_fd);
+			_epoll_fd = -1;
+			errno = errsv;
+
+			return -1;
+		}
+	}
+
+	/* timerfd doesn't support every clock. The caller falls back to the service engine on failure. */
+	if ((timer->tfd = timerfd_create(timer->clockid, TFD_NONBLOCK)) < 0)
+		return -1;
+
+	timer->gen = ++ _timers_gen;
+
+	event.events = EPOLLIN;
+	event.data.u64 = (((uint64_t) timer->gen) << 32) | timer->slot;
 
-		/* Update number of allocated timer control slots */
-		_nr_timers ++;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, timer->tfd, &event) < 0) {
+		errsv = errno;
+		close(timer->tfd);
+		errno = errsv;
+
+		return -1;
 	}
 
-	/* Reset timer memory */
-	memset(&_timers[slot], 0, sizeof(struct timer_ul));
+	timer->engine = PSCHED_TIMER_UL_ENGINE_TIMERFD;
+
+	return 0;
+}
+#endif
+
+/* API */
+int timer_create_ul(clockid_t clockid, struct sigevent *sevp, timer_t *timerid) {
+	int errsv = 0;
+	struct timer_ul *timer = NULL;
 
 	/* Validate clockid value */
 	switch (clockid) {
@@ -287,6 +595,10 @@ int timer_create_ul(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
 		} break;
 		case CLOCK_MONOTONIC: {
 		} break;
+#ifdef CLOCK_BOOTTIME
+		case CLOCK_BOOTTIME: {
+		} break;
+#endif
 #ifndef PSCHED_TIMER_UL_NO_CPUTIME
 		case CLOCK_PROCESS_CPUTIME_ID: {
 		} break;
@@ -294,18 +606,15 @@ int timer_create_ul(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
 		} break;
 #endif
 		default: {
-			errsv = EINVAL;
-			goto _create_failure;
+			errno = EINVAL;
+			return -1;
 		}
 	}
 
-	/* Set the clock id */
-	_timers[slot].clockid = clockid;
-
 	/* Validate sigevent */
 	if (!sevp) {
-		errsv = EINVAL;
-		goto _create_failure;
+		errno = EINVAL;
+		return -1;
 	}
 
 	switch (sevp->sigev_notify) {
@@ -315,63 +624,85 @@ int timer_create_ul(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
 		} break;
 		case SIGEV_SIGNAL:
 		default: {
-			errsv = EINVAL;
-			goto _create_failure;
+			errno = EINVAL;
+			return -1;
 		}
 	}
 
-	/* Store sigevent data */
-	memcpy(&_timers[slot].sevp, sevp, sizeof(struct sigevent));
+	/* Acquire slots critical region lock */
+	pthread_mutex_lock(&_mutex_slots);
 
-	/* Grant that ID is never 0 */
-	*timerid = _timers[slot].id = (timer_t) (uintptr_t) (slot + 1); /* Grant that ID is never 0 */
+	/* Grab a free slot, allocating a new page of slots if none is left */
+	if (!_free && (_slot_grow() < 0)) {
+		errsv = errno;
+		goto _create_failure;
+	}
 
-	/* Initialize timer thread cond and mutex */
-	pthread_mutex_init(&_timers[slot].t_mutex, NULL);
-	pthread_cond_init(&_timers[slot].t_cond_h, NULL);
-	pthread_cond_init(&_timers[slot].t_cond_p, NULL);
+	timer = _free;
 
-	/* Timer mutex shall be acquired before thread is created */
-	pthread_mutex_lock(&_timers[slot].t_mutex);
+	/* Reset timer data. The lock and the free list linkage are kept. */
+	timer->engine = PSCHED_TIMER_UL_ENGINE_SERVICE;
+	timer->clockid = clockid;
+	timer->overruns = 0;
+	timer->overrun = 0;
+	timer->armed = 0;
+	timer->heap_pos = 0;
+	timer->service = NULL;
+	timer->tfd = -1;
 
-	/* Create a thread to process this timer */
-	if ((errno = pthread_create(&_timers[slot].t_id, NULL, &_timer_process, &_timers[slot]))) {
-		errsv = errno;
-		pthread_mutex_unlock(&_timers[slot].t_mutex);
-		pthread_mutex_destroy(&_timers[slot].t_mutex);
-		pthread_cond_destroy(&_timers[slot].t_cond_h);
-		pthread_cond_destroy(&_timers[slot].t_cond_p);
-		goto _create_failure;
+	/* Store sigevent data */
+	memset(&timer->notify, 0, sizeof(struct timer_ul_notify));
+	memcpy(&timer->notify.sevp, sevp, sizeof(struct sigevent));
+
+	timer->notify.work.routine = &_notify_routine;
+	timer->notify.work.arg = timer;
+
+	/* Each timer delivers its notifications on a thread of its own, so a slow notification only delays the
+	 * next expirations of the same timer.
+	 */
+	if (sevp->sigev_notify == SIGEV_THREAD) {
+		if (exec_init(&timer->notify.exec, 1, 0, sevp->sigev_notify_attributes ? sevp->sigev_notify_attributes : _thread_attr_get()) < 0) {
+			errsv = errno;
+			goto _create_failure;
+		}
+
+		_nr_notify ++;
 	}
 
-	/* Create the timer pipe and set the read end as non-block */
-	if ((pipe(_timers[slot].wait_pipe) < 0) || (_fd_set_nonblock(_timers[slot].wait_pipe[0]) < 0)) {
-		pthread_cancel(_timers[slot].t_id);
-		pthread_join(_timers[slot].t_id, NULL);
-		pthread_mutex_unlock(&_timers[slot].t_mutex);
-		pthread_mutex_destroy(&_timers[slot].t_mutex);
-		pthread_cond_destroy(&_timers[slot].t_cond_h);
-		pthread_cond_destroy(&_timers[slot].t_cond_p);
-		goto _create_failure; /* Out of options */
+#ifdef PSCHED_TIMER_UL_TIMERFD
+	/* Prefer the timerfd engine */
+	if (_timerfd_create(timer) < 0)
+#endif
+	{
+		if (!(timer->service = _service_get(clockid))) {
+			errsv = errno;
+			goto _create_failure_notify;
+		}
 	}
 
-	/* Wait for the newly created timer inform that it's in initialized state */
-	while (!(_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_INIT_FLAG))
-		pthread_cond_wait(&_timers[slot].t_cond_h, &_timers[slot].t_mutex);
+	_free = timer->free_next;
+	timer->free_next = NULL;
 
-	/* Release the timer mutex */
-	pthread_mutex_unlock(&_timers[slot].t_mutex);
+	/* Publish the timer. Grant that ID is never 0. */
+	pthread_mutex_lock(&timer->mutex);
+	*timerid = timer->id = (timer_t) (uintptr_t) (timer->slot + 1);
+	pthread_mutex_unlock(&timer->mutex);
 
-	/* Release timers critical region lock */
-	pthread_mutex_unlock(&_mutex_timers);
+	/* Release slots critical region lock */
+	pthread_mutex_unlock(&_mutex_slots);
 
 	/* All good */
 	return 0;
 
-_create_failure:
-	memset(&_timers[slot], 0, sizeof(struct timer_ul));
+_create_failure_notify:
+	if (sevp->sigev_notify == SIGEV_THREAD) {
+		exec_destroy(&timer->notify.exec);
+
+		_nr_notify --;
+	}
 
-	pthread_mutex_unlock(&_mutex_timers);
+_create_failure:
+	pthread_mutex_unlock(&_mutex_slots);
 
 	errno = errsv;
 
@@ -379,56 +710,50 @@ _create_failure:
 }
 
 int timer_delete_ul(timer_t timerid) {
-	int i = 0, used = 0;
-	uintptr_t slot = ((uintptr_t) timerid) - 1;
-	struct itimerspec disarm = { { 0, 0 }, { 0, 0 } };
+	struct timer_ul *timer = NULL;
 
-	/* Sanity check */
-	if (slot >= _nr_timers) {
-		errno = EINVAL;
-		return -1;
-	}
-
-	/* Disarm timer, if armed */
-	if (timer_settime_ul(timerid, 0, &disarm, NULL) < 0)
+	if (!(timer = _timer_lock(timerid)))
 		return -1;
 
-	/* Cancel the timer thread and wait for it to join */
-	pthread_cancel(_timers[slot].t_id);
-	pthread_join(_timers[slot].t_id, NULL);
+	switch (timer->engine) {
+#ifdef PSCHED_TIMER_UL_TIMERFD
+		case PSCHED_TIMER_UL_ENGINE_TIMERFD: {
+			/* Once the id is cleared, pending epoll events for this timer are ignored */
+			epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, timer->tfd, NULL);
+			close(timer->tfd);
+		} break;
+#endif
+		case PSCHED_TIMER_UL_ENGINE_SERVICE: {
+			/* Disarm timer, if armed */
+			pthread_mutex_lock(&timer->service->mutex);
+			_service_heap_remove(timer->service, timer);
+			timer->armed = 0;
+			pthread_mutex_unlock(&timer->service->mutex);
+		} break;
+	}
 
-	/* Destroy mutexes */
-	pthread_cond_destroy(&_timers[slot].t_cond_h);
-	pthread_cond_destroy(&_timers[slot].t_cond_p);
-	pthread_mutex_destroy(&_timers[slot].t_mutex);
+	timer->id = NULL;
 
-	/* Close pipe */
-	close(_timers[slot].wait_pipe[0]);
-	close(_timers[slot].wait_pipe[1]);
+	pthread_mutex_unlock(&timer->mutex);
 
-	/* Cleanup timer data */
-	memset(&_timers[slot], 0, sizeof(struct timer_ul));
+	/* Drop any pending notification and stop the notification thread. This can't be done under the timer
+	 * lock, as the notification may be running and using the timer.
+	 */
+	if (timer->notify.sevp.sigev_notify == SIGEV_THREAD) {
+		exec_cancel(&timer->notify.exec, &timer->notify.work);
+		exec_destroy(&timer->notify.exec);
+	}
 
-	/* Entering critical region */
-	pthread_mutex_lock(&_mutex_timers);
+	/* Return the slot to the free list */
+	pthread_mutex_lock(&_mutex_slots);
 
-	/* Check if the list is still being used, and peform some cleanup */
-	for (i = 0; i < _nr_timers; i ++) {
-		if (_timers[i].id) {
-			used = 1;
-			break;
-		}
-	}
+	if (timer->notify.sevp.sigev_notify == SIGEV_THREAD)
+		_nr_notify --;
 
-	/* If unused, free all the resources */
-	if (!used) {
-		_nr_timers = 0;
-		mm_free(_timers);
-		_timers = NULL;
-	}
+	timer->free_next = _free;
+	_free = timer;
 
-	/* Leaving critical region */
-	pthread_mutex_unlock(&_mutex_timers);
+	pthread_mutex_unlock(&_mutex_slots);
 
 	/* All good */
 	return 0;
@@ -440,160 +765,173 @@ int timer_settime_ul(
 	const struct itimerspec *new_value,
 	struct itimerspec *old_value)
 {
-	int errsv = 0;
-	uintptr_t slot = ((uintptr_t) timerid) - 1;
-
-	/* Sanity check */
-	if (slot >= _nr_timers) {
-		errno = EINVAL;
-		return -1;
-	}
+	int errsv = 0, ret = 0;
+	struct timer_ul *timer = NULL;
 
 	if (!new_value) {
 		errno = EFAULT;
 		return -1;
 	}
 
-	/* Acquire timers critical region lock */
-	pthread_mutex_lock(&_mutex_timers);
+	if (!(timer = _timer_lock(timerid)))
+		return -1;
 
-	/* Acquire the target timer thread mutex */
-	pthread_mutex_lock(&_timers[slot].t_mutex);
+#ifdef PSCHED_TIMER_UL_TIMERFD
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_TIMERFD) {
+		ret = timerfd_settime(timer->tfd, (flags & TIMER_ABSTIME) ? TFD_TIMER_ABSTIME : 0, new_value, old_value);
+	} else
+#endif
+	{
+		pthread_mutex_lock(&timer->service->mutex);
 
-	/* Check if this timer shall be disarmed */
-	if (_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_ARMED_FLAG) {
-		/* Disarm timer */
-		_timers[slot].t_flags &= ~PSCHED_TIMER_UL_THREAD_ARMED_FLAG;
+		/* Copy last known value and interval */
+		if (old_value)
+			_service_gettime(timer, old_value);
 
-		/* Interrupt timer */
-		write(_timers[slot].wait_pipe[1], (char [1]) { 0 }, 1);
+		ret = _service_settime(timer, flags, new_value);
 
-		_timers[slot].t_flags |= PSCHED_TIMER_UL_THREAD_INTR_FLAG;
+		errsv = errno;
 
-		/* Wait for interrupt to occur */
-		while (_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_INTR_FLAG)
-			pthread_cond_wait(&_timers[slot].t_cond_h, &_timers[slot].t_mutex);
+		pthread_mutex_unlock(&timer->service->mutex);
 
-		/* Copy last known value and interval */
-		if (old_value)
-			memcpy(old_value, &_timers[slot].arm, sizeof(struct itimerspec));
+		errno = errsv;
 	}
 
-	/* If it this is a disarm operation ... */
-	if (!new_value->it_value.tv_sec && !new_value->it_value.tv_nsec) {
-		pthread_mutex_unlock(&_timers[slot].t_mutex);
-		pthread_mutex_unlock(&_mutex_timers);
+	errsv = errno;
 
-		return 0;
-	}
+	pthread_mutex_unlock(&timer->mutex);
 
-	/* Reset timer state */
-	memset(&_timers[slot].rem, 0, sizeof(struct timespec));
-	memset(&_timers[slot].arm, 0, sizeof(struct itimerspec));
+	errno = errsv;
 
-	/* Set the init time */
-	if (clock_gettime(_timers[slot].clockid, &_timers[slot].init_time) < 0) {
-		errsv = errno;
-		pthread_mutex_unlock(&_timers[slot].t_mutex);
-		goto _settime_failure;
+	return ret;
+}
+
+int timer_gettime_ul(timer_t timerid, struct itimerspec *curr_value) {
+	int errsv = 0, ret = 0;
+	struct timer_ul *timer = NULL;
+
+	if (!curr_value) {
+		errno = EFAULT;
+		return -1;
 	}
 
-	/* Set flags */
-	_timers[slot].flags = flags;
+	if (!(timer = _timer_lock(timerid)))
+		return -1;
+
+#ifdef PSCHED_TIMER_UL_TIMERFD
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_TIMERFD) {
+		ret = timerfd_gettime(timer->tfd, curr_value);
+	} else
+#endif
+	{
+		pthread_mutex_lock(&timer->service->mutex);
+		_service_gettime(timer, curr_value);
+		pthread_mutex_unlock(&timer->service->mutex);
+	}
 
-	/* Copy the timer values */
-	memcpy(&_timers[slot].arm, new_value, sizeof(struct itimerspec));
+	errsv = errno;
 
-	/* Set the timer to initialized state */
-	_timers[slot].t_flags |= PSCHED_TIMER_UL_THREAD_INIT_FLAG;
+	pthread_mutex_unlock(&timer->mutex);
 
-	/* Arm the timer */
-	_timers[slot].t_flags |= PSCHED_TIMER_UL_THREAD_ARMED_FLAG;
+	errno = errsv;
 
-	/* Release the timer thread */
-	pthread_cond_signal(&_timers[slot].t_cond_p);
+	return ret;
+}
 
-	/* Wait for timer thread to leave initialized state */
-	while (_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_INIT_FLAG)
-		pthread_cond_wait(&_timers[slot].t_cond_h, &_timers[slot].t_mutex);
+int timer_getoverrun_ul(timer_t timerid) {
+	int overruns = 0;
+	struct timer_ul *timer = NULL;
 
-	/* Release the timer mutex */
-	pthread_mutex_unlock(&_timers[slot].t_mutex);
+	if (!(timer = _timer_lock(timerid)))
+		return -1;
 
-	/* Release timers critical region lock */
-	pthread_mutex_unlock(&_mutex_timers);
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_SERVICE)
+		pthread_mutex_lock(&timer->service->mutex);
 
-	/* All good */
-	return 0;
+	overruns = timer->overrun;
 
-_settime_failure:
-	/* Release timers critical region lock */
-	pthread_mutex_unlock(&_mutex_timers);
+	if (timer->engine == PSCHED_TIMER_UL_ENGINE_SERVICE)
+		pthread_mutex_unlock(&timer->service->mutex);
 
-	errno = errsv;
+	pthread_mutex_unlock(&timer->mutex);
 
-	return -1;
+	return overruns;
 }
 
-int timer_gettime_ul(timer_t timerid, struct itimerspec *curr_value) {
-	uintptr_t slot = ((uintptr_t) timerid) - 1;
+/* Sets the stack size of the threads created by the userland timers. Must be called before the first timer is
+ * created.
+ */
+int timer_setstacksize_ul(size_t stacksize) {
+	int errsv = 0;
 
-	/* Sanity check */
-	if (slot >= _nr_timers) {
-		errno = EINVAL;
-		return -1;
-	}
+	pthread_mutex_lock(&_mutex_slots);
 
-	if (!curr_value) {
-		errno = EFAULT;
-		return -1;
-	}
+	if (_thread_attr_busy())
+		errsv = EBUSY;
+	else if (!_thread_attr_get())
+		errsv = ENOMEM;
+	else if (stacksize)
+		errsv = pthread_attr_setstacksize(&_thread_attr, stacksize);
 
-	/* Acquire timers critical region lock */
-	pthread_mutex_lock(&_mutex_timers);
+	pthread_mutex_unlock(&_mutex_slots);
 
-	if (!(_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_ARMED_FLAG)) {
-		/* If the timer isn't armed, return error */
-		errno = EINVAL;
+	if (errsv) {
+		errno = errsv;
 		return -1;
 	}
 
-	/* Acquire the target timer thread mutex */
-	pthread_mutex_lock(&_timers[slot].t_mutex);
+	return 0;
+}
 
-	/* This is a read operation */
-	_timers[slot].t_flags |= PSCHED_TIMER_UL_THREAD_READ_FLAG;
+/* Sets the attributes (stack size, scheduling and CPU affinity) of the threads created by the userland timers.
+ * Must be called before the first timer is created.
+ */
+int timer_setattr_ul(const pthread_attr_t *attr) {
+	int errsv = 0, val = 0;
+	size_t stacksize = 0;
+	struct sched_param param;
+#ifdef __linux__
+	cpu_set_t cpuset;
+#endif
 
-	/* Interrupt thread if it's sleeping */
-	write(_timers[slot].wait_pipe[1], (char [1]) { 0 }, 1);
+	pthread_mutex_lock(&_mutex_slots);
 
-	/* Wait until the timer updates data */
-	while (_timers[slot].t_flags & PSCHED_TIMER_UL_THREAD_READ_FLAG)
-		pthread_cond_wait(&_timers[slot].t_cond_h, &_timers[slot].t_mutex);
+	if (_thread_attr_busy()) {
+		errsv = EBUSY;
+		goto _setattr_failure;
+	}
 
-	/* Populate the curr_value */
-	memcpy(&curr_value->it_interval, &_timers[slot].arm.it_interval, sizeof(struct timespec));
-	memcpy(&curr_value->it_value, &_timers[slot].rem, sizeof(struct timespec));
+	if (!_thread_attr_get()) {
+		errsv = ENOMEM;
+		goto _setattr_failure;
+	}
 
-	/* Release the target timer thread mutex */
-	pthread_mutex_unlock(&_timers[slot].t_mutex);
+	/* Attributes can't be copied as a whole, so each one of them is transferred */
+	if (!(errsv = pthread_attr_getstacksize(attr, &stacksize)))
+		errsv = pthread_attr_setstacksize(&_thread_attr, stacksize);
 
-	/* Release timers critical region lock */
-	pthread_mutex_unlock(&_mutex_timers);
+	if (!errsv && !(errsv = pthread_attr_getinheritsched(attr, &val)))
+		errsv = pthread_attr_setinheritsched(&_thread_attr, val);
 
-	return 0;
-}
+	if (!errsv && !(errsv = pthread_attr_getschedpolicy(attr, &val)))
+		errsv = pthread_attr_setschedpolicy(&_thread_attr, val);
 
-int timer_getoverrun_ul(timer_t timerid) {
-	uintptr_t slot = ((uintptr_t) timerid) - 1;
+	if (!errsv && !(errsv = pthread_attr_getschedparam(attr, &param)))
+		errsv = pthread_attr_setschedparam(&_thread_attr, &param);
 
-	/* Sanity check */
-	if (slot >= _nr_timers) {
-		errno = EINVAL;
+#ifdef __linux__
+	if (!errsv && !(errsv = pthread_attr_getaffinity_np(attr, sizeof(cpu_set_t), &cpuset)))
+		errsv = pthread_attr_setaffinity_np(&_thread_attr, sizeof(cpu_set_t), &cpuset);
+#endif
+
+_setattr_failure:
+	pthread_mutex_unlock(&_mutex_slots);
+
+	if (errsv) {
+		errno = errsv;
 		return -1;
 	}
 
-	return _timers[slot].overruns;
+	return 0;
 }
 
-
@@ -25,6 +25,7 @@
  */
 
 
+#include <stdint.h>
 #include <time.h>
 
 void timespec_sub(struct timespec *dest, const struct timespec *src) {
@@ -63,3 +64,12 @@ int timespec_cmp(const struct timespec *ts1, const struct timespec *ts2) {
 	return 0;
 }
 
+uint64_t timespec_to_ns(const struct timespec *ts) {
+	return ((uint64_t) ts->tv_sec * 1000000000) + ts->tv_nsec;
+}
+
+void timespec_from_ns(struct timespec *ts, uint64_t ns) {
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
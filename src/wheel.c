@@ -0,0 +1,285 @@
+/**
+ * @file wheel.c
+ * @brief Portable Scheduler Library (libpsched)
+ *        Hierarchical timing wheel interface
+ *
+ * Date: 16-10-2026
+ * 
+ * Copyright 2014-2015 Pedro A. Hortas (pah@ucodev.org)
+ *
+ * This file is part of libpsched.
+ *
+ * libpsched is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpsched is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libpsched.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "mm.h"
+#include "psched.h"
+#include "timespec.h"
+#include "wheel.h"
+
+/* Default tick length, if none is specified (1 millisecond) */
+#define PSCHED_WHEEL_TICK_DEFAULT	1000000
+
+/* Statics */
+static uint64_t _wheel_tick_of(const struct psched_wheel *wheel, const struct timespec *ts, int round_up) {
+	struct timespec rel;
+	uint64_t ns = 0;
+
+	/* Anything before the wheel start belongs to tick 0 */
+	if (timespec_cmp(ts, &wheel->start) <= 0)
+		return 0;
+
+	memcpy(&rel, ts, sizeof(struct timespec));
+	timespec_sub(&rel, &wheel->start);
+
+	ns = ((uint64_t) rel.tv_sec * 1000000000) + rel.tv_nsec;
+
+	return round_up ? ((ns + wheel->tick - 1) / wheel->tick) : (ns / wheel->tick);
+}
+
+static void _wheel_link(struct psched_entry **head, struct psched_entry *entry) {
+	if ((entry->wheel_next = *head))
+		(*head)->wheel_pprev = &entry->wheel_next;
+
+	entry->wheel_pprev = head;
+	*head = entry;
+}
+
+static void _wheel_unlink(struct psched_entry *entry) {
+	if ((*entry->wheel_pprev = entry->wheel_next))
+		entry->wheel_next->wheel_pprev = entry->wheel_pprev;
+
+	entry->wheel_next = NULL;
+	entry->wheel_pprev = NULL;
+}
+
+static void _wheel_place(struct psched_wheel *wheel, struct psched_entry *entry) {
+	uint64_t tick = entry->wheel_tick, delta = 0;
+	unsigned int level = 0, slot = 0;
+
+	/* Entries whose tick was already reached are due right away */
+	if (tick <= wheel->now) {
+		entry->wheel_slot = -1;
+		_wheel_link(&wheel->due, entry);
+
+		return;
+	}
+
+	delta = tick - wheel->now;
+
+	/* Find the lowest level that is able to hold this delta */
+	for (level = 0; level < (PSCHED_WHEEL_LEVELS - 1); level ++) {
+		if (delta < ((uint64_t) 1 << (PSCHED_WHEEL_BITS * (level + 1))))
+			break;
+	}
+
+	/* Deltas beyond the wheel range are placed on the last bucket of the top level and cascaded again later */
+	if (delta >= ((uint64_t) 1 << (PSCHED_WHEEL_BITS * PSCHED_WHEEL_LEVELS)))
+		tick = wheel->now + ((uint64_t) 1 << (PSCHED_WHEEL_BITS * PSCHED_WHEEL_LEVELS)) - 1;
+
+	slot = (tick >> (PSCHED_WHEEL_BITS * level)) & PSCHED_WHEEL_MASK;
+
+	entry->wheel_slot = (level * PSCHED_WHEEL_SLOTS) + slot;
+	_wheel_link(&wheel->slots[level][slot], entry);
+
+	wheel->map[level] |= (uint64_t) 1 << slot;
+	wheel->count ++;
+}
+
+static void _wheel_cascade(struct psched_wheel *wheel, unsigned int level) {
+	unsigned int slot = (wheel->now >> (PSCHED_WHEEL_BITS * level)) & PSCHED_WHEEL_MASK;
+	struct psched_entry *entry = NULL;
+
+	/* Re-place every entry of the current bucket on the lower levels */
+	while ((entry = wheel->slots[level][slot])) {
+		_wheel_unlink(entry);
+		wheel->count --;
+
+		_wheel_place(wheel, entry);
+	}
+
+	wheel->map[level] &= ~((uint64_t) 1 << slot);
+}
+
+static void _wheel_advance(struct psched_wheel *wheel, uint64_t target) {
+	unsigned int level = 0, slot = 0;
+	struct psched_entry *entry = NULL;
+	uint64_t skip = 0;
+
+	while (wheel->now < target) {
+		/* If there's nothing on the buckets, just jump to the target */
+		if (!wheel->count) {
+			wheel->now = target;
+			break;
+		}
+
+		/* If there's nothing on level 0, jump straight to the next cascade */
+		if (!wheel->map[0]) {
+			skip = (wheel->now | PSCHED_WHEEL_MASK);
+
+			wheel->now = (skip < target) ? skip : target;
+
+			if (wheel->now == target)
+				break;
+		}
+
+		wheel->now ++;
+
+		/* Find the highest level that must be cascaded on this tick */
+		for (level = 0; (level + 1) < PSCHED_WHEEL_LEVELS; level ++) {
+			if (wheel->now & (((uint64_t) 1 << (PSCHED_WHEEL_BITS * (level + 1))) - 1))
+				break;
+		}
+
+		/* Cascade from the highest level down, so lower buckets receive the entries before being cascaded */
+		for (; level > 0; level --)
+			_wheel_cascade(wheel, level);
+
+		/* Move the current level 0 bucket to the due list */
+		slot = wheel->now & PSCHED_WHEEL_MASK;
+
+		while ((entry = wheel->slots[0][slot])) {
+			_wheel_unlink(entry);
+			wheel->count --;
+
+			entry->wheel_slot = -1;
+			_wheel_link(&wheel->due, entry);
+		}
+
+		wheel->map[0] &= ~((uint64_t) 1 << slot);
+	}
+}
+
+static unsigned int _wheel_offset(uint64_t map, unsigned int pos) {
+	unsigned int k = 0;
+
+	/* Distance (1 to PSCHED_WHEEL_SLOTS) from 'pos' to the next non-empty bucket, wrapping around */
+	for (k = 1; k <= PSCHED_WHEEL_SLOTS; k ++) {
+		if (map & ((uint64_t) 1 << ((pos + k) & PSCHED_WHEEL_MASK)))
+			return k;
+	}
+
+	return 0;
+}
+
+/* API */
+struct psched_wheel *wheel_init(const struct timespec *start, const struct timespec *tick) {
+	struct psched_wheel *wheel = NULL;
+
+	if (!(wheel = mm_alloc(sizeof(struct psched_wheel))))
+		return NULL;
+
+	memset(wheel, 0, sizeof(struct psched_wheel));
+
+	memcpy(&wheel->start, start, sizeof(struct timespec));
+
+	if (tick)
+		wheel->tick = ((uint64_t) tick->tv_sec * 1000000000) + tick->tv_nsec;
+
+	if (!wheel->tick)
+		wheel->tick = PSCHED_WHEEL_TICK_DEFAULT;
+
+	return wheel;
+}
+
+void wheel_destroy(struct psched_wheel *wheel) {
+	mm_free(wheel);
+}
+
+void wheel_insert(struct psched_wheel *wheel, struct psched_entry *entry) {
+	entry->wheel_tick = _wheel_tick_of(wheel, &entry->deadline, 1);
+
+	_wheel_place(wheel, entry);
+}
+
+void wheel_remove(struct psched_wheel *wheel, struct psched_entry *entry) {
+	unsigned int level = 0, slot = 0;
+
+	/* Nothing to do if the entry isn't queued */
+	if (!entry->wheel_pprev)
+		return;
+
+	_wheel_unlink(entry);
+
+	/* Entries on the due list aren't accounted on the buckets */
+	if (entry->wheel_slot < 0)
+		return;
+
+	level = entry->wheel_slot / PSCHED_WHEEL_SLOTS;
+	slot = entry->wheel_slot % PSCHED_WHEEL_SLOTS;
+
+	if (!wheel->slots[level][slot])
+		wheel->map[level] &= ~((uint64_t) 1 << slot);
+
+	wheel->count --;
+}
+
+int wheel_next(const struct psched_wheel *wheel, struct timespec *deadline) {
+	unsigned int level = 0, pos = 0, k = 0;
+	uint64_t tick = 0, next = 0;
+	int found = 0;
+
+	if (wheel->due) {
+		/* Something is already due */
+		next = wheel->now;
+		found = 1;
+	} else {
+		/* Look for the closest non-empty bucket (or cascade) on each level */
+		for (level = 0; level < PSCHED_WHEEL_LEVELS; level ++) {
+			if (!wheel->map[level])
+				continue;
+
+			pos = (wheel->now >> (PSCHED_WHEEL_BITS * level)) & PSCHED_WHEEL_MASK;
+			k = _wheel_offset(wheel->map[level], pos);
+
+			tick = ((wheel->now >> (PSCHED_WHEEL_BITS * level)) + k) << (PSCHED_WHEEL_BITS * level);
+
+			if (!found || (tick < next)) {
+				next = tick;
+				found = 1;
+			}
+		}
+	}
+
+	if (!found)
+		return 0;
+
+	/* Convert the tick into an absolute time */
+	deadline->tv_sec = (next * wheel->tick) / 1000000000;
+	deadline->tv_nsec = (next * wheel->tick) % 1000000000;
+
+	timespec_add(deadline, &wheel->start);
+
+	return 1;
+}
+
+struct psched_entry *wheel_pop(struct psched_wheel *wheel, const struct timespec *now) {
+	struct psched_entry *entry = NULL;
+
+	/* Turn the wheel up to the current time */
+	_wheel_advance(wheel, _wheel_tick_of(wheel, now, 0));
+
+	if (!(entry = wheel->due))
+		return NULL;
+
+	_wheel_unlink(entry);
+
+	return entry;
+}
+